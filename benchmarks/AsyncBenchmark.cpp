@@ -0,0 +1,56 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "BenchmarkCommon.hpp"
+#include <deque>
+
+using namespace isonata::bench;
+
+/*
+ * Measures the throughput of asynchronous stores as a function of the
+ * number of requests kept in flight (queue depth).
+ *
+ * Usage: isonata-async-benchmark [backend] [num_ops] [doc_size]
+ */
+int main(int argc, char** argv) {
+    std::string backend = argc > 1 ? argv[1] : "yokan";
+    size_t num_ops  = argc > 2 ? std::atol(argv[2]) : 100000;
+    size_t doc_size = argc > 3 ? std::atol(argv[3]) : 128;
+
+    pid_t pid;
+    auto addr = spawnServer(backend, &pid);
+
+    auto engine = tl::engine("na+sm", THALLIUM_CLIENT_MODE);
+    auto admin = isonata::Admin::create(engine, backend);
+    admin.createDatabase(addr, 0, "benchdb", resource_type, resource_config);
+    {
+        auto client = isonata::Client::create(engine, backend);
+        auto db = client.open(addr, 0, "benchdb");
+        auto coll = db.create("bench");
+        auto doc = makeDocument(doc_size);
+
+        std::cout << "queue_depth,ops_per_second" << std::endl;
+        for(size_t depth : {1, 4, 16, 64, 256, 1024, 16384}) {
+            std::deque<isonata::AsyncRequest> window;
+            std::vector<uint64_t> ids(num_ops);
+            auto t = timeIt(num_ops, [&](size_t i) {
+                if(window.size() == depth) {
+                    window.front().wait();
+                    window.pop_front();
+                }
+                window.emplace_back();
+                coll.store(doc, &ids[i], false, &window.back());
+                if(i + 1 == num_ops)
+                    for(auto& req : window) req.wait();
+            });
+            std::cout << depth << "," << 1e6/t << std::endl;
+        }
+        db.drop("bench");
+    }
+    admin.destroyDatabase(addr, 0, "benchdb");
+    stopServer(admin, addr, pid);
+    engine.finalize();
+    return 0;
+}
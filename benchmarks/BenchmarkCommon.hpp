@@ -0,0 +1,95 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_BENCHMARK_COMMON_HPP
+#define __ISONATA_BENCHMARK_COMMON_HPP
+
+#include <isonata/Admin.hpp>
+#include <isonata/Provider.hpp>
+#include <isonata/Client.hpp>
+#include <thallium.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace isonata {
+namespace bench {
+
+namespace tl = thallium;
+
+static const std::string resource_type = "unqlite";
+static constexpr const char* resource_config = "{ \"path\" : \"benchdb\", \"mode\":\"create\" }";
+
+/**
+ * @brief Forks a server process running an ISonata provider of the
+ * given backend over na+sm, so that the client side of the benchmark
+ * goes through the network layer rather than through Margo's self-RPC
+ * shortcut. Returns the address of the server.
+ */
+inline std::string spawnServer(const std::string& backend, pid_t* pid) {
+    int fds[2];
+    if(pipe(fds) != 0) {
+        std::cerr << "Could not create pipe" << std::endl;
+        std::exit(1);
+    }
+    *pid = fork();
+    if(*pid == 0) {
+        close(fds[0]);
+        auto engine = tl::engine("na+sm", THALLIUM_SERVER_MODE);
+        engine.enable_remote_shutdown();
+        auto provider = Provider::create(engine, backend);
+        std::string addr = engine.self();
+        addr.push_back('\n');
+        if(write(fds[1], addr.data(), addr.size()) != (ssize_t)addr.size())
+            std::exit(1);
+        close(fds[1]);
+        engine.wait_for_finalize();
+        std::exit(0);
+    }
+    close(fds[1]);
+    std::string addr;
+    char c;
+    while(read(fds[0], &c, 1) == 1 && c != '\n') addr.push_back(c);
+    close(fds[0]);
+    return addr;
+}
+
+/**
+ * @brief Shuts down the server started by spawnServer.
+ */
+inline void stopServer(const Admin& admin, const std::string& addr, pid_t pid) {
+    admin.shutdownServer(addr);
+    waitpid(pid, nullptr, 0);
+}
+
+/**
+ * @brief Runs the function n times and returns the average
+ * time per call in microseconds.
+ */
+template<typename Function>
+double timeIt(size_t n, Function&& f) {
+    auto t1 = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < n; ++i) f(i);
+    auto t2 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(t2 - t1).count() / n;
+}
+
+/**
+ * @brief Makes a JSON document of approximately the requested size.
+ */
+inline std::string makeDocument(size_t size, size_t seed = 0) {
+    std::string doc = "{\"id\":" + std::to_string(seed) + ",\"payload\":\"";
+    doc.append(size > doc.size() + 2 ? size - doc.size() - 2 : 0, 'x');
+    doc += "\"}";
+    return doc;
+}
+
+} // namespace bench
+} // namespace isonata
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "BenchmarkCommon.hpp"
+#include <isonata/JsonCodec.hpp>
+#include <random>
+
+using namespace isonata::bench;
+using isonata::json;
+
+/**
+ * @brief Makes a document shaped like the records of a typical
+ * workflow: metadata strings, nested objects, tags, and an array of
+ * num_values measurements.
+ */
+static json makeRecord(size_t num_values, std::mt19937_64& rng) {
+    std::uniform_real_distribution<double> value(-1e3, 1e3);
+    json record = {
+        {"run", rng() % 1000},
+        {"event", rng()},
+        {"name", "detector-" + std::to_string(rng() % 64)},
+        {"valid", rng() % 2 == 0},
+        {"calibration", {{"version", "v2.3.1"}, {"offset", value(rng)},
+                         {"gain", value(rng)}, {"reference", nullptr}}},
+        {"tags", {"raw", "calibrated", "zone-" + std::to_string(rng() % 8)}}
+    };
+    auto& values = record["values"] = json::array();
+    for(size_t i = 0; i < num_values; ++i) {
+        values.push_back({{"t", i}, {"x", value(rng)}, {"q", rng() % 256}});
+    }
+    return record;
+}
+
+/**
+ * @brief User type read from the documents with SAX events, summing
+ * the "x" fields without building a json value.
+ */
+class SumOfX : public json::json_sax_t {
+
+    bool m_in_x = false;
+
+public:
+
+    double sum = 0;
+
+    bool null() override { m_in_x = false; return true; }
+    bool boolean(bool) override { m_in_x = false; return true; }
+    bool number_integer(number_integer_t v) override { if(m_in_x) sum += v; m_in_x = false; return true; }
+    bool number_unsigned(number_unsigned_t v) override { if(m_in_x) sum += v; m_in_x = false; return true; }
+    bool number_float(number_float_t v, const string_t&) override { if(m_in_x) sum += v; m_in_x = false; return true; }
+    bool string(string_t&) override { m_in_x = false; return true; }
+    bool binary(binary_t&) override { return true; }
+    bool start_object(std::size_t) override { return true; }
+    bool key(string_t& k) override { m_in_x = (k == "x"); return true; }
+    bool end_object() override { return true; }
+    bool start_array(std::size_t) override { m_in_x = false; return true; }
+    bool end_array() override { return true; }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override {
+        return false;
+    }
+};
+
+/*
+ * Compares the registered JSON codecs (see isonata::JsonCodec) on
+ * documents of several sizes: serialization, parsing into json values,
+ * and SAX parsing into a user type. Does not need a server.
+ *
+ * Usage: isonata-codec-benchmark [num_docs]
+ */
+int main(int argc, char** argv) {
+    size_t num_docs = argc > 1 ? std::atol(argv[1]) : 1000;
+
+    std::cout << "codec,values_per_doc,bytes_per_doc,dump_us,parse_us,sax_us,parse_MBps" << std::endl;
+    for(size_t num_values : {8, 64, 512}) {
+        std::mt19937_64 rng(num_values);
+        std::vector<json> records;
+        for(size_t i = 0; i < num_docs; ++i) records.push_back(makeRecord(num_values, rng));
+        std::vector<std::string> docs(num_docs);
+        size_t bytes = 0;
+        for(size_t i = 0; i < num_docs; ++i) {
+            docs[i] = records[i].dump();
+            bytes += docs[i].size();
+        }
+
+        for(const auto& name : isonata::JsonCodec::names()) {
+            auto codec = isonata::JsonCodec::get(name);
+            std::string out;
+            auto dump_us = timeIt(num_docs, [&](size_t i) { codec->dump(records[i], out); });
+            json parsed;
+            auto parse_us = timeIt(num_docs, [&](size_t i) { parsed = codec->parse(docs[i]); });
+            SumOfX sax;
+            auto sax_us = timeIt(num_docs, [&](size_t i) { codec->sax_parse(docs[i], sax); });
+            std::cout << name << "," << num_values << "," << bytes/num_docs << ","
+                      << dump_us << "," << parse_us << "," << sax_us << ","
+                      << (bytes/num_docs)/parse_us << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "BenchmarkCommon.hpp"
+#include <random>
+
+using namespace isonata::bench;
+
+/*
+ * Measures the throughput of point lookups issued by many concurrent
+ * ULTs, through a plain Collection handle and through combining
+ * handles with several batch sizes (see Collection::combining).
+ *
+ * Usage: isonata-combining-benchmark [backend] [num_ults] [fetches_per_ult] [num_docs]
+ */
+int main(int argc, char** argv) {
+    std::string backend = argc > 1 ? argv[1] : "yokan";
+    size_t num_ults  = argc > 2 ? std::atol(argv[2]) : 256;
+    size_t num_ops   = argc > 3 ? std::atol(argv[3]) : 1000;
+    size_t num_docs  = argc > 4 ? std::atol(argv[4]) : 10000;
+
+    pid_t pid;
+    auto addr = spawnServer(backend, &pid);
+
+    auto engine = tl::engine("na+sm", THALLIUM_CLIENT_MODE);
+    auto admin = isonata::Admin::create(engine, backend);
+    admin.createDatabase(addr, 0, "benchdb", resource_type, resource_config);
+    {
+        auto client = isonata::Client::create(engine, backend);
+        auto db = client.open(addr, 0, "benchdb");
+        auto coll = db.create("bench");
+        std::vector<std::string> docs;
+        for(size_t i = 0; i < num_docs; ++i) docs.push_back(makeDocument(128, i));
+        std::vector<uint64_t> ids(num_docs);
+        coll.store_multi(docs, ids.data());
+
+        auto run = [&](const isonata::Collection& handle) {
+            auto pool = tl::xstream::self().get_main_pools(1)[0];
+            auto t1 = std::chrono::steady_clock::now();
+            std::vector<tl::managed<tl::thread>> ults;
+            for(size_t u = 0; u < num_ults; ++u) {
+                ults.push_back(pool.make_thread([&, u]() {
+                    std::mt19937_64 rng(u);
+                    std::string doc;
+                    for(size_t i = 0; i < num_ops; ++i)
+                        handle.fetch(ids[rng() % num_docs], &doc);
+                }));
+            }
+            for(auto& ult : ults) ult->join();
+            auto t2 = std::chrono::steady_clock::now();
+            return num_ults*num_ops/std::chrono::duration<double>(t2 - t1).count();
+        };
+
+        std::cout << "mode,max_records,fetches_per_second" << std::endl;
+        std::cout << "plain,1," << run(coll) << std::endl;
+        for(size_t max_records : {8, 32, 128, 512}) {
+            isonata::CombiningOptions options;
+            options.max_records = max_records;
+            std::cout << "combined," << max_records << ","
+                      << run(coll.combining(options)) << std::endl;
+        }
+        db.drop("bench");
+    }
+    admin.destroyDatabase(addr, 0, "benchdb");
+    stopServer(admin, addr, pid);
+    engine.finalize();
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "BenchmarkCommon.hpp"
+#include <isonata/Database.hpp>
+#include <yokan/cxx/client.hpp>
+#include <yokan/cxx/collection.hpp>
+#include <numeric>
+#include <random>
+
+using namespace isonata::bench;
+using isonata::json;
+
+/**
+ * @brief Makes a small, repetitive document: the same keys in every
+ * document and values drawn from small sets.
+ */
+static json makeRecord(size_t i, std::mt19937_64& rng) {
+    static const char* statuses[] = {"queued", "running", "done", "failed"};
+    return {
+        {"job", i},
+        {"user", "user" + std::to_string(rng() % 50)},
+        {"status", statuses[rng() % 4]},
+        {"partition", "compute-" + std::to_string(rng() % 8)},
+        {"resources", {{"nodes", 1 + rng() % 16}, {"gpus_per_node", 4}, {"memory", "256GB"}}},
+        {"elapsed", (rng() % 100000) / 10.0}
+    };
+}
+
+/*
+ * Compares the compression options of collections (see
+ * Database::create) on small, repetitive documents: bytes per document
+ * as stored by the provider, compression ratio against uncompressed
+ * JSON, and throughput of storing and fetching the documents as json
+ * values, in MB of JSON text per second. Requires ISonata to be built
+ * with ENABLE_ZSTD.
+ *
+ * Usage: isonata-compression-benchmark [num_docs]
+ */
+int main(int argc, char** argv) {
+    size_t num_docs = argc > 1 ? std::atol(argv[1]) : 10000;
+
+    pid_t pid;
+    auto addr = spawnServer("yokan", &pid);
+
+    auto engine = tl::engine("na+sm", THALLIUM_CLIENT_MODE);
+    auto admin = isonata::Admin::create(engine, "yokan");
+    admin.createDatabase(addr, 0, "benchdb", resource_type, resource_config);
+    {
+        auto client = isonata::Client::create(engine, "yokan");
+        auto db = client.open(addr, 0, "benchdb");
+
+        auto ep = engine.lookup(addr);
+        auto ykclient = yokan::Client{engine.get_margo_instance()};
+        auto ykdb = ykclient.findDatabaseByName(ep.get_addr(), 0, "benchdb");
+
+        std::mt19937_64 rng(0);
+        auto records = json::array();
+        size_t text_bytes = 0;
+        for(size_t i = 0; i < num_docs; ++i) {
+            records.push_back(makeRecord(i, rng));
+            text_bytes += records.back().dump().size();
+        }
+        auto samples = json::array();
+        for(size_t i = 0; i < 1000; ++i) samples.push_back(makeRecord(i, rng));
+
+        std::vector<std::pair<std::string, json>> configs = {
+            {"json",                json::object()},
+            {"json+zstd1",          {{"compression", {{"method", "zstd"}, {"level", 1}}}}},
+            {"json+zstd3",          {{"compression", "zstd"}}},
+            {"json+zstd3+dict",     {{"compression", {{"method", "zstd"}, {"dictionary_samples", samples}}}}},
+            {"msgpack+zstd3+dict",  {{"format", "msgpack"},
+                                     {"compression", {{"method", "zstd"}, {"dictionary_samples", samples}}}}}
+        };
+
+        std::cout << "config,stored_bytes_per_doc,ratio,store_MBps,fetch_MBps" << std::endl;
+        for(const auto& [name, options] : configs) {
+            auto coll = db.create("bench", options);
+            std::vector<uint64_t> ids(num_docs);
+            auto store_us = timeIt(1, [&](size_t) {
+                coll.store_multi(records, ids.data());
+            });
+            json fetched;
+            auto fetch_us = timeIt(1, [&](size_t) {
+                coll.fetch_multi(ids.data(), ids.size(), &fetched);
+            });
+            std::vector<size_t> sizes(num_docs);
+            yokan::Collection{"bench", ykdb}.lengthMulti(num_docs, ids.data(), sizes.data());
+            auto bytes = std::accumulate(sizes.begin(), sizes.end(), size_t{0});
+            std::cout << name << "," << bytes/num_docs << ","
+                      << double(text_bytes)/bytes << ","
+                      << text_bytes/store_us << "," << text_bytes/fetch_us << std::endl;
+            db.drop("bench");
+        }
+    }
+    admin.destroyDatabase(addr, 0, "benchdb");
+    stopServer(admin, addr, pid);
+    engine.finalize();
+    return 0;
+}
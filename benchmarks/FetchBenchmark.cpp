@@ -0,0 +1,123 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "BenchmarkCommon.hpp"
+#include <yokan/cxx/client.hpp>
+#include <yokan/cxx/collection.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace isonata::bench;
+
+/*
+ * Compares the per-operation latency of Collection::fetch and
+ * fetch_multi, which load documents in a single packed RPC when the
+ * client's buffer estimate is large enough, with the two-RPC scheme
+ * (yokan length followed by load), on a collection mixing small,
+ * medium and large documents fetched in random order.
+ *
+ * A fetch whose documents do not fit the estimated buffer falls back
+ * to two more RPCs, roughly tripling its latency. The fallback rate is
+ * therefore estimated as the fraction of calls taking more than twice
+ * the median latency of the workload.
+ *
+ * Usage: isonata-fetch-benchmark [num_ops] [num_docs]
+ */
+
+/**
+ * @brief Times each call separately and returns the average latency
+ * in microseconds, setting slow_rate to the fraction of calls taking
+ * more than twice the median.
+ */
+template<typename Function>
+static double timeEach(size_t n, Function&& f, double* slow_rate) {
+    std::vector<double> us(n);
+    for(size_t i = 0; i < n; ++i) us[i] = timeIt(1, [&](size_t) { f(i); });
+    auto sorted = us;
+    std::nth_element(sorted.begin(), sorted.begin() + n/2, sorted.end());
+    const auto median = sorted[n/2];
+    double total = 0;
+    size_t slow = 0;
+    for(auto t : us) {
+        total += t;
+        if(t > 2*median) ++slow;
+    }
+    *slow_rate = static_cast<double>(slow)/n;
+    return total/n;
+}
+
+int main(int argc, char** argv) {
+    size_t num_ops  = argc > 1 ? std::atol(argv[1]) : 10000;
+    size_t num_docs = argc > 2 ? std::atol(argv[2]) : 1000;
+    constexpr size_t multi_count = 8;
+
+    pid_t pid;
+    auto addr = spawnServer("yokan", &pid);
+
+    auto engine = tl::engine("na+sm", THALLIUM_CLIENT_MODE);
+    auto admin = isonata::Admin::create(engine, "yokan");
+    admin.createDatabase(addr, 0, "benchdb", resource_type, resource_config);
+    {
+        auto client = isonata::Client::create(engine, "yokan");
+        auto db = client.open(addr, 0, "benchdb");
+        auto coll = db.create("bench");
+
+        auto ep = engine.lookup(addr);
+        auto ykclient = yokan::Client{engine.get_margo_instance()};
+        auto ykdb = ykclient.findDatabaseByName(ep.get_addr(), 0, "benchdb");
+        auto ykcoll = yokan::Collection{"bench", ykdb};
+
+        // 70% of 64 B, 25% of 1 KiB and 5% of 64 KiB documents
+        std::mt19937_64 rng{42};
+        std::discrete_distribution<int> pick{70, 25, 5};
+        const size_t sizes[] = {64, 1024, 65536};
+        std::vector<uint64_t> ids(num_docs);
+        for(size_t i = 0; i < num_docs; ++i)
+            ids[i] = coll.store(makeDocument(sizes[pick(rng)], i));
+        std::vector<uint64_t> order(num_ops*multi_count);
+        std::uniform_int_distribution<size_t> any{0, num_docs - 1};
+        for(auto& id : order) id = ids[any(rng)];
+
+        std::cout << "operation,two_rpc_us,isonata_us,two_rpc_slow_rate,isonata_slow_rate" << std::endl;
+        double two_rpc_slow, slow;
+        auto two_rpc = timeEach(num_ops, [&](size_t i) {
+            size_t size = ykcoll.length(order[i]);
+            std::string buffer(size, '\0');
+            ykcoll.load(order[i], &buffer[0], &size);
+        }, &two_rpc_slow);
+        auto single = timeEach(num_ops, [&](size_t i) {
+            std::string buffer;
+            coll.fetch(order[i], &buffer);
+        }, &slow);
+        std::cout << "fetch," << two_rpc << "," << single << ","
+                  << two_rpc_slow << "," << slow << std::endl;
+
+        two_rpc = timeEach(num_ops, [&](size_t i) {
+            const auto batch = &order[i*multi_count];
+            std::vector<size_t> lengths(multi_count);
+            ykcoll.lengthMulti(multi_count, batch, lengths.data());
+            std::vector<std::string> buffers(multi_count);
+            std::vector<void*> ptrs(multi_count);
+            for(size_t j = 0; j < multi_count; ++j) {
+                buffers[j].resize(lengths[j]);
+                ptrs[j] = &buffers[j][0];
+            }
+            ykcoll.loadMulti(multi_count, batch, ptrs.data(), lengths.data());
+        }, &two_rpc_slow);
+        auto multi = timeEach(num_ops, [&](size_t i) {
+            isonata::DocumentBatch batch;
+            coll.fetch_multi(&order[i*multi_count], multi_count, &batch);
+        }, &slow);
+        std::cout << "fetch_multi_" << multi_count << "," << two_rpc << "," << multi << ","
+                  << two_rpc_slow << "," << slow << std::endl;
+
+        db.drop("bench");
+    }
+    admin.destroyDatabase(addr, 0, "benchdb");
+    stopServer(admin, addr, pid);
+    engine.finalize();
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "BenchmarkCommon.hpp"
+#include <isonata/Database.hpp>
+#include <isonata/DocumentFormat.hpp>
+#include <yokan/cxx/client.hpp>
+#include <yokan/cxx/collection.hpp>
+#include <numeric>
+#include <random>
+
+using namespace isonata::bench;
+using isonata::json;
+
+/*
+ * Compares the storage formats of collections (see
+ * isonata::DocumentFormat) on numeric-heavy records holding an array
+ * of num_values doubles: bytes per document as stored by the provider,
+ * and per-document time of storing and fetching them as json values.
+ *
+ * Usage: isonata-format-benchmark [num_docs]
+ */
+int main(int argc, char** argv) {
+    size_t num_docs = argc > 1 ? std::atol(argv[1]) : 1000;
+
+    pid_t pid;
+    auto addr = spawnServer("yokan", &pid);
+
+    auto engine = tl::engine("na+sm", THALLIUM_CLIENT_MODE);
+    auto admin = isonata::Admin::create(engine, "yokan");
+    admin.createDatabase(addr, 0, "benchdb", resource_type, resource_config);
+    {
+        auto client = isonata::Client::create(engine, "yokan");
+        auto db = client.open(addr, 0, "benchdb");
+
+        auto ep = engine.lookup(addr);
+        auto ykclient = yokan::Client{engine.get_margo_instance()};
+        auto ykdb = ykclient.findDatabaseByName(ep.get_addr(), 0, "benchdb");
+
+        std::cout << "format,values_per_doc,stored_bytes_per_doc,store_us,fetch_us" << std::endl;
+        for(size_t num_values : {16, 256, 4096}) {
+            std::mt19937_64 rng(num_values);
+            std::uniform_real_distribution<double> value(-1e6, 1e6);
+            auto records = json::array();
+            for(size_t i = 0; i < num_docs; ++i) {
+                auto& record = records.emplace_back(json{{"step", i}, {"name", "sensor"}});
+                auto& values = record["values"] = json::array();
+                for(size_t j = 0; j < num_values; ++j) values.push_back(value(rng));
+            }
+            for(auto format : {isonata::DocumentFormat::JSON, isonata::DocumentFormat::CBOR,
+                               isonata::DocumentFormat::MessagePack, isonata::DocumentFormat::BSON}) {
+                auto name = isonata::format_name(format);
+                auto coll = db.create("bench", {{"format", name}});
+                std::vector<uint64_t> ids(num_docs);
+                auto store_us = timeIt(1, [&](size_t) {
+                    coll.store_multi(records, ids.data());
+                }) / num_docs;
+                json fetched;
+                auto fetch_us = timeIt(1, [&](size_t) {
+                    coll.fetch_multi(ids.data(), ids.size(), &fetched);
+                }) / num_docs;
+                std::vector<size_t> sizes(num_docs);
+                yokan::Collection{"bench", ykdb}.lengthMulti(num_docs, ids.data(), sizes.data());
+                auto bytes = std::accumulate(sizes.begin(), sizes.end(), size_t{0});
+                std::cout << name << "," << num_values << "," << bytes/num_docs << ","
+                          << store_us << "," << fetch_us << std::endl;
+                db.drop("bench");
+            }
+        }
+    }
+    admin.destroyDatabase(addr, 0, "benchdb");
+    stopServer(admin, addr, pid);
+    engine.finalize();
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "BenchmarkCommon.hpp"
+#include <isonata/RequestQueue.hpp>
+
+using namespace isonata::bench;
+using json = nlohmann::json;
+
+/*
+ * Measures the latency of small fetches while large JSON documents
+ * are stored asynchronously (their serialization runs in the client's
+ * async pool), for several placements of the async pool: the engine's
+ * progress pool (0 xstreams) or a dedicated pool with N xstreams.
+ *
+ * Usage: isonata-pool-benchmark [backend] [num_fetches] [doc_size]
+ */
+int main(int argc, char** argv) {
+    std::string backend = argc > 1 ? argv[1] : "yokan";
+    size_t num_fetches = argc > 2 ? std::atol(argv[2]) : 10000;
+    size_t doc_size    = argc > 3 ? std::atol(argv[3]) : 1024*1024;
+
+    pid_t pid;
+    auto addr = spawnServer(backend, &pid);
+
+    auto engine = tl::engine("na+sm", THALLIUM_CLIENT_MODE);
+    auto admin = isonata::Admin::create(engine, backend);
+    admin.createDatabase(addr, 0, "benchdb", resource_type, resource_config);
+    {
+        auto large = json::parse(makeDocument(doc_size));
+
+        std::cout << "async_xstreams,fetch_latency_us" << std::endl;
+        for(size_t num_xstreams : {0, 1, 2, 4}) {
+            json config;
+            config["async"]["num_xstreams"] = num_xstreams;
+            auto client = isonata::Client::create(engine, backend, config);
+            auto db = client.open(addr, 0, "benchdb");
+            auto coll = db.create("bench");
+            auto small_id = coll.store(makeDocument(64));
+
+            bool stopping = false;
+            auto writer = tl::xstream::self().get_main_pools(1)[0].make_thread([&]() {
+                isonata::RequestQueue queue{coll, 16};
+                while(!stopping) queue.store(json(large));
+                queue.flush();
+            });
+
+            std::string doc;
+            auto t = timeIt(num_fetches, [&](size_t) {
+                coll.fetch(small_id, &doc);
+            });
+            std::cout << num_xstreams << "," << t << std::endl;
+
+            stopping = true;
+            writer->join();
+            db.drop("bench");
+        }
+    }
+    admin.destroyDatabase(addr, 0, "benchdb");
+    stopServer(admin, addr, pid);
+    engine.finalize();
+    return 0;
+}
@@ -6,6 +6,8 @@
 #ifndef __ISONATA_ASYNC_REQUEST_HPP
 #define __ISONATA_ASYNC_REQUEST_HPP
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <isonata/Exception.hpp>
@@ -22,6 +24,10 @@ public:
 
   virtual bool completed() const = 0;
 
+  virtual uint64_t on_completion(std::function<void()> callback) const = 0;
+
+  virtual void remove_callback(uint64_t id) const = 0;
+
   virtual operator bool() const = 0;
 };
 
@@ -60,6 +66,60 @@ public:
       } catch(const std::exception& ex) { throw Exception(ex.what()); }
   }
 
+  /**
+   * @brief Registers a function to call once the request has
+   * completed. If the request has already completed, the function
+   * is called immediately by the calling ULT.
+   *
+   * @return An id to pass to remove_callback, or 0 if the function
+   * was called immediately.
+   */
+  uint64_t on_completion(std::function<void()> callback) const override {
+      try {
+         return self->on_completion(std::move(callback));
+      } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Unregisters a function registered with on_completion, if
+   * it has not been called yet.
+   *
+   * @param id Id returned by on_completion.
+   */
+  void remove_callback(uint64_t id) const override {
+      try {
+         self->remove_callback(id);
+      } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Registers a continuation to run once the request has
+   * completed, without any ULT having to block in wait(). The
+   * continuation receives the request, on which it can call wait()
+   * to obtain the error, if any, without blocking. With the Yokan
+   * backend, the continuation runs in the ULT that completed the
+   * operation; with Sonata, in a ULT waiting on the request. If the
+   * request has already completed, the continuation runs immediately
+   * in the calling ULT. Exceptions thrown by the continuation are
+   * ignored.
+   *
+   * Note that the continuation may still be running when wait()
+   * returns in another ULT. Continuations may issue new asynchronous
+   * operations (e.g. to chain a fetch and an update) but should not
+   * block waiting for them, since they may be holding one of the
+   * backend's worker ULTs.
+   *
+   * @param continuation Function to call on completion.
+   */
+  void then(std::function<void(const AsyncRequest&)> continuation) const {
+      auto req = *this;
+      on_completion([req, continuation=std::move(continuation)]() {
+          try {
+              continuation(req);
+          } catch(...) {}
+      });
+  }
+
   /**
    * @brief Checks if the object is valid.
    */
@@ -0,0 +1,260 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_ASYNC_REQUEST_SET_HPP
+#define __ISONATA_ASYNC_REQUEST_SET_HPP
+
+#include <isonata/AsyncRequest.hpp>
+#include <isonata/Exception.hpp>
+#include <thallium.hpp>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief An AsyncRequestSet tracks a set of requests and lets the
+ * caller block until any or all of them complete. Requests notify the
+ * set when they complete, so waiting does not poll the requests one by
+ * one. Each request added to the set receives an index, which is
+ * reused once the request has been returned by wait_any or test_some,
+ * making the set convenient to keep a fixed window of operations.
+ */
+class AsyncRequestSet {
+
+  struct State {
+    tl::mutex              mutex;
+    tl::condition_variable cv;
+    std::deque<size_t>     completed;
+  };
+
+  std::shared_ptr<State>    m_state = std::make_shared<State>();
+  std::vector<AsyncRequest> m_requests;
+  std::vector<size_t>       m_free;
+  size_t                    m_pending = 0;
+
+  std::pair<size_t, AsyncRequest> release(size_t index) {
+    auto req = std::move(m_requests[index]);
+    m_requests[index] = AsyncRequest{};
+    m_free.push_back(index);
+    m_pending -= 1;
+    return {index, std::move(req)};
+  }
+
+public:
+
+  AsyncRequestSet() = default;
+  AsyncRequestSet(AsyncRequestSet&&) = default;
+  AsyncRequestSet& operator=(AsyncRequestSet&&) = default;
+  AsyncRequestSet(const AsyncRequestSet&) = delete;
+  AsyncRequestSet& operator=(const AsyncRequestSet&) = delete;
+  ~AsyncRequestSet() = default;
+
+  /**
+   * @brief Adds a request to the set.
+   *
+   * @param req Request to track.
+   *
+   * @return The index associated with the request.
+   */
+  size_t add(AsyncRequest req) {
+    size_t index;
+    if(m_free.empty()) {
+      index = m_requests.size();
+      m_requests.emplace_back();
+    } else {
+      index = m_free.back();
+      m_free.pop_back();
+    }
+    m_requests[index] = std::move(req);
+    m_pending += 1;
+    auto state = m_state;
+    m_requests[index].on_completion([state, index]() {
+      {
+        std::unique_lock<tl::mutex> lock{state->mutex};
+        state->completed.push_back(index);
+      }
+      state->cv.notify_all();
+    });
+    return index;
+  }
+
+  /**
+   * @brief Number of requests in the set.
+   */
+  size_t size() const {
+    return m_pending;
+  }
+
+  /**
+   * @brief Whether the set is empty.
+   */
+  bool empty() const {
+    return m_pending == 0;
+  }
+
+  /**
+   * @brief Blocks until one of the requests completes, removes it
+   * from the set and returns it along with its index. The returned
+   * request has completed, so calling wait() on it returns immediately
+   * (or throws if the operation failed).
+   */
+  std::pair<size_t, AsyncRequest> wait_any() {
+    if(m_pending == 0)
+      throw Exception("wait_any called on an empty AsyncRequestSet");
+    size_t index;
+    {
+      std::unique_lock<tl::mutex> lock{m_state->mutex};
+      m_state->cv.wait(lock, [this]() { return !m_state->completed.empty(); });
+      index = m_state->completed.front();
+      m_state->completed.pop_front();
+    }
+    return release(index);
+  }
+
+  /**
+   * @brief Removes and returns the requests that have completed,
+   * without blocking.
+   */
+  std::vector<std::pair<size_t, AsyncRequest>> test_some() {
+    std::deque<size_t> completed;
+    {
+      std::unique_lock<tl::mutex> lock{m_state->mutex};
+      completed.swap(m_state->completed);
+    }
+    std::vector<std::pair<size_t, AsyncRequest>> result;
+    result.reserve(completed.size());
+    for(auto index : completed) result.push_back(release(index));
+    return result;
+  }
+
+  /**
+   * @brief Blocks until all the requests have completed and removes
+   * them from the set. If any operation failed, the first error
+   * is rethrown once all the requests have completed.
+   */
+  void wait_all() {
+    std::exception_ptr error;
+    while(m_pending != 0) {
+      auto completed = wait_any();
+      try {
+        completed.second.wait();
+      } catch(...) {
+        if(!error) error = std::current_exception();
+      }
+    }
+    if(error) std::rethrow_exception(error);
+  }
+};
+
+/**
+ * @brief Blocks until all the requests have completed. A completion
+ * counter is used, so the calling ULT is woken up only once. If any
+ * operation failed, the first error is rethrown.
+ *
+ * @param reqs Array of requests.
+ * @param count Number of requests.
+ */
+inline void wait_all(const AsyncRequest* reqs, size_t count) {
+  struct State {
+    tl::mutex              mutex;
+    tl::condition_variable cv;
+    size_t                 remaining;
+  };
+  auto state = std::make_shared<State>();
+  state->remaining = count;
+  for(size_t i = 0; i < count; ++i) {
+    reqs[i].on_completion([state]() {
+      std::unique_lock<tl::mutex> lock{state->mutex};
+      if(--state->remaining == 0) state->cv.notify_all();
+    });
+  }
+  {
+    std::unique_lock<tl::mutex> lock{state->mutex};
+    state->cv.wait(lock, [&state]() { return state->remaining == 0; });
+  }
+  std::exception_ptr error;
+  for(size_t i = 0; i < count; ++i) {
+    try {
+      reqs[i].wait();
+    } catch(...) {
+      if(!error) error = std::current_exception();
+    }
+  }
+  if(error) std::rethrow_exception(error);
+}
+
+/**
+ * @brief Blocks until at least one of the requests has completed
+ * and returns its index. The requests are not waited on, so errors
+ * are reported when calling wait() on the returned request. Prefer
+ * an AsyncRequestSet when calling this function repeatedly on the
+ * same requests.
+ *
+ * @param reqs Array of requests.
+ * @param count Number of requests.
+ *
+ * @return The index of a completed request.
+ */
+inline size_t wait_any(const AsyncRequest* reqs, size_t count) {
+  if(count == 0)
+    throw Exception("wait_any called on an empty array of requests");
+  struct State {
+    tl::mutex              mutex;
+    tl::condition_variable cv;
+    size_t                 index = std::numeric_limits<size_t>::max();
+  };
+  auto state = std::make_shared<State>();
+  std::vector<uint64_t> callbacks;
+  callbacks.reserve(count);
+  for(size_t i = 0; i < count; ++i) {
+    callbacks.push_back(reqs[i].on_completion([state, i]() {
+      std::unique_lock<tl::mutex> lock{state->mutex};
+      if(state->index == std::numeric_limits<size_t>::max()) {
+        state->index = i;
+        state->cv.notify_all();
+      }
+    }));
+    if(reqs[i].completed()) break;
+  }
+  size_t index;
+  {
+    std::unique_lock<tl::mutex> lock{state->mutex};
+    state->cv.wait(lock, [&state]() {
+      return state->index != std::numeric_limits<size_t>::max();
+    });
+    index = state->index;
+  }
+  // the requests that have not completed would otherwise keep the
+  // callbacks of every call
+  for(size_t i = 0; i < callbacks.size(); ++i)
+    if(callbacks[i]) reqs[i].remove_callback(callbacks[i]);
+  return index;
+}
+
+/**
+ * @brief Returns the indices of the requests that have completed,
+ * without blocking.
+ *
+ * @param reqs Array of requests.
+ * @param count Number of requests.
+ *
+ * @return The indices of the completed requests.
+ */
+inline std::vector<size_t> test_some(const AsyncRequest* reqs, size_t count) {
+  std::vector<size_t> result;
+  for(size_t i = 0; i < count; ++i)
+    if(reqs[i].completed()) result.push_back(i);
+  return result;
+}
+
+} // namespace isonata
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_ASYNC_RESULT_HPP
+#define __ISONATA_ASYNC_RESULT_HPP
+
+#include <isonata/AsyncRequest.hpp>
+#include <isonata/Exception.hpp>
+#include <memory>
+#include <type_traits>
+
+namespace isonata {
+
+namespace detail {
+
+template<typename T>
+struct AsyncResultState {
+  AsyncRequest          request;
+  T                     value{};
+  std::shared_ptr<void> payload;
+};
+
+template<>
+struct AsyncResultState<void> {
+  AsyncRequest          request;
+  std::shared_ptr<void> payload;
+};
+
+} // namespace detail
+
+/**
+ * @brief An AsyncResult is a future-like object returned by the
+ * *_async functions of Collection. It owns the operation's payload
+ * (if any) and its result, so the caller neither has to keep the
+ * payload alive nor provide memory for the result. Copies of an
+ * AsyncResult share the same state.
+ */
+template<typename T>
+class AsyncResult {
+
+  std::shared_ptr<detail::AsyncResultState<T>> m_state
+    = std::make_shared<detail::AsyncResultState<T>>();
+
+public:
+
+  AsyncResult() = default;
+  AsyncResult(AsyncResult&&) = default;
+  AsyncResult(const AsyncResult&) = default;
+  AsyncResult& operator=(AsyncResult&&) = default;
+  AsyncResult& operator=(const AsyncResult&) = default;
+  ~AsyncResult() = default;
+
+  /**
+   * @brief Waits for the operation to complete and returns
+   * a reference to its result. Rethrows the operation's error, if any.
+   */
+  template<typename U = T>
+  std::enable_if_t<!std::is_void<U>::value, U&> get() const {
+    wait();
+    return m_state->value;
+  }
+
+  /**
+   * @brief Waits for the operation to complete.
+   */
+  void wait() const {
+    m_state->request.wait();
+  }
+
+  /**
+   * @brief Tests whether the operation has completed, without blocking.
+   */
+  bool completed() const {
+    return m_state->request.completed();
+  }
+
+  /**
+   * @brief Returns the underlying request, e.g. to add it to an
+   * AsyncRequestSet or to register a continuation with then().
+   */
+  const AsyncRequest& request() const {
+    return m_state->request;
+  }
+
+  /**
+   * @brief The following functions are meant for backend
+   * implementations, which set the request, write the result,
+   * and attach the payload that the operation needs.
+   */
+  AsyncRequest* request_ptr() const {
+    return &m_state->request;
+  }
+
+  template<typename U = T>
+  std::enable_if_t<!std::is_void<U>::value, U*> value_ptr() const {
+    return &m_state->value;
+  }
+
+  void set_payload(std::shared_ptr<void> payload) const {
+    m_state->payload = std::move(payload);
+  }
+};
+
+} // namespace isonata
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <memory>
 #include <isonata/Database.hpp>
+#include <isonata/DocumentCache.hpp>
 #include <isonata/ProviderHandle.hpp>
 #include <thallium.hpp>
 
@@ -62,6 +63,51 @@ public:
    */
   static Client create(const tl::engine& engine, const std::string& impl);
 
+  /**
+   * @brief Same as above, with a configuration for the client.
+   * The "async" field configures where asynchronous operations run:
+   *
+   * {
+   *   "async": {
+   *     "num_xstreams": 1, // execution streams of the dedicated pool,
+   *                        // or 0 to use the engine's progress pool
+   *     "num_workers": 1024, // maximum number of operations running at
+   *                          // once, hence of RPCs in flight
+   *     "num_serializers": 1 // ULTs serializing or parsing the documents
+   *                          // of a large batch (default: num_xstreams)
+   *   }
+   * }
+   *
+   * By default, asynchronous operations run in a dedicated pool served
+   * by one execution stream created on first use. Worker ULTs are
+   * created as the number of pending operations grows, up to
+   * num_workers; operations submitted beyond that cap wait in the queue
+   * until a worker is free. The Sonata backend ignores this
+   * configuration.
+   *
+   * @param engine Engine.
+   * @param impl Implementation name.
+   * @param config Client configuration.
+   *
+   * @return Client.
+   */
+  static Client create(const tl::engine& engine, const std::string& impl,
+                       const nlohmann::json& config);
+
+  /**
+   * @brief Same as above, running asynchronous operations in the
+   * provided pool, which should be served by at least one execution
+   * stream for as long as the client is in use.
+   *
+   * @param engine Engine.
+   * @param impl Implementation name.
+   * @param pool Pool in which to run asynchronous operations.
+   *
+   * @return Client.
+   */
+  static Client create(const tl::engine& engine, const std::string& impl,
+                       const tl::pool& pool);
+
   Client() = default;
   Client(Client&&) = default;
   Client(const Client&) = default;
@@ -69,6 +115,22 @@ public:
   Client& operator=(const Client&) = default;
   ~Client() = default;
 
+  /**
+   * @brief Returns a handle to the same client whose databases and
+   * collections keep the documents they fetch in the provided cache,
+   * so that fetching the same record again does not issue an RPC.
+   * Updates, erases and code executed through this handle invalidate
+   * the cached documents they may modify; modifications made through
+   * other clients are not seen until the document is evicted. Only
+   * fetches of single records (fetch, fetch_async and fetch_json_async)
+   * use the cache. The cache may be shared by multiple clients.
+   *
+   * @param cache Document cache.
+   *
+   * @return A caching handle to the client.
+   */
+  Client cached(std::shared_ptr<DocumentCache> cache) const;
+
   /**
    * @brief Returns the thallium engine used by the client.
    */
@@ -7,10 +7,16 @@
 #define __ISONATA_COLLECTION_HPP
 
 #include <isonata/AsyncRequest.hpp>
+#include <isonata/AsyncResult.hpp>
+#include <isonata/DocumentBatch.hpp>
 #include <isonata/Exception.hpp>
+#include <isonata/JsonCodec.hpp>
 #include <thallium.hpp>
 #include <nlohmann/json.hpp>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <string_view>
 
 namespace isonata {
 
@@ -50,7 +56,7 @@ public:
 
   virtual void store(const json &record, uint64_t *id, bool commit,
                      AsyncRequest *req) const {
-    store(record.dump(), id, commit, req);
+    store(JsonCodec::current().dump(record), id, commit, req);
   }
 
   virtual void store(const char *record, uint64_t *id, bool commit,
@@ -80,6 +86,12 @@ public:
     store_multi(vec, ids, commit, req);
   }
 
+  virtual void store_multi(const char *data, const size_t *sizes, size_t count,
+                           uint64_t *ids, bool commit, AsyncRequest *req) const = 0;
+
+  virtual void store_multi(const std::string_view *records, size_t count,
+                           uint64_t *ids, bool commit, AsyncRequest *req) const = 0;
+
   virtual void fetch(uint64_t id, std::string *result,
                      AsyncRequest *req) const = 0;
 
@@ -93,12 +105,18 @@ public:
   virtual void fetch_multi(const uint64_t *id, size_t count, json *result,
                            AsyncRequest *req) const = 0;
 
+  virtual void fetch_multi(const uint64_t *ids, size_t count, DocumentBatch *result,
+                           AsyncRequest *req) const = 0;
+
   virtual void filter(const std::string &filterCode, std::vector<std::string> *result,
                       AsyncRequest *req) const = 0;
 
   virtual void filter(const std::string &filterCode, json *result,
                       AsyncRequest *req) const = 0;
 
+  virtual void filter(const std::string &filterCode, DocumentBatch *result,
+                      AsyncRequest *req) const = 0;
+
   virtual void update(uint64_t id, const json &record, bool commit,
                       AsyncRequest *req) const = 0;
 
@@ -130,10 +148,72 @@ public:
     return update_multi(ids, vec, updated, commit, req);
   }
 
+  virtual void update_multi(const uint64_t *ids, const char *data,
+                            const size_t *sizes, size_t count,
+                            std::vector<bool> *updated, bool commit,
+                            AsyncRequest *req) const = 0;
+
+  virtual void update_multi(const uint64_t *ids, const std::string_view *records,
+                            size_t count, std::vector<bool> *updated, bool commit,
+                            AsyncRequest *req) const = 0;
+
   virtual void all(std::vector<std::string> *result, AsyncRequest *req) const = 0;
 
   virtual void all(json *result, AsyncRequest *req) const = 0;
 
+  virtual void all(DocumentBatch *result, AsyncRequest *req) const = 0;
+
+  virtual void all(const std::function<void(const std::vector<std::string>&)> &callback,
+                   size_t batch_size, AsyncRequest *req) const = 0;
+
+  virtual AsyncResult<uint64_t> store_async(std::string &&record, bool commit) const {
+    auto payload = std::make_shared<std::string>(std::move(record));
+    AsyncResult<uint64_t> result;
+    result.set_payload(payload);
+    store(*payload, result.value_ptr(), commit, result.request_ptr());
+    return result;
+  }
+
+  virtual AsyncResult<uint64_t> store_async(json &&record, bool commit) const {
+    return store_async(JsonCodec::current().dump(record), commit);
+  }
+
+  virtual AsyncResult<std::vector<uint64_t>> store_multi_async(
+        std::vector<std::string> &&records, bool commit) const {
+    auto payload = std::make_shared<std::vector<std::string>>(std::move(records));
+    AsyncResult<std::vector<uint64_t>> result;
+    result.set_payload(payload);
+    result.value_ptr()->resize(payload->size());
+    store_multi(*payload, result.value_ptr()->data(), commit, result.request_ptr());
+    return result;
+  }
+
+  virtual AsyncResult<std::string> fetch_async(uint64_t id) const {
+    AsyncResult<std::string> result;
+    fetch(id, result.value_ptr(), result.request_ptr());
+    return result;
+  }
+
+  virtual AsyncResult<json> fetch_json_async(uint64_t id) const {
+    AsyncResult<json> result;
+    fetch(id, result.value_ptr(), result.request_ptr());
+    return result;
+  }
+
+  virtual AsyncResult<void> update_async(uint64_t id, std::string &&record,
+                                         bool commit) const {
+    auto payload = std::make_shared<std::string>(std::move(record));
+    AsyncResult<void> result;
+    result.set_payload(payload);
+    update(id, *payload, commit, result.request_ptr());
+    return result;
+  }
+
+  virtual AsyncResult<void> update_async(uint64_t id, json &&record,
+                                         bool commit) const {
+    return update_async(id, JsonCodec::current().dump(record), commit);
+  }
+
   virtual uint64_t last_record_id() const = 0;
 
   virtual size_t size() const = 0;
@@ -143,12 +223,75 @@ public:
 
   virtual void erase_multi(const uint64_t *ids, size_t size, bool commit,
                            AsyncRequest *req) const = 0;
+
+  virtual void fetch_range(uint64_t first, size_t count, DocumentBatch *result,
+                           AsyncRequest *req) const = 0;
+
+  virtual void fetch_range(uint64_t first, size_t count,
+                           std::vector<std::string> *result,
+                           AsyncRequest *req) const = 0;
+
+  virtual void erase_range(uint64_t first, size_t count, bool commit,
+                           AsyncRequest *req) const = 0;
+
+  virtual void fetch(uint64_t id, const std::vector<std::string> &fields,
+                     json *result, AsyncRequest *req) const = 0;
+
+  virtual void fetch_multi(const uint64_t *ids, size_t count,
+                           const std::vector<std::string> &fields,
+                           json *result, AsyncRequest *req) const = 0;
+
+  virtual void filter(const std::string &filterCode,
+                      const std::vector<std::string> &fields,
+                      json *result, AsyncRequest *req) const = 0;
+
+  virtual void patch(uint64_t id, const json &patch, bool commit,
+                     AsyncRequest *req) const = 0;
+
+  virtual void patch_multi(const uint64_t *ids, size_t count, const json &patch,
+                           bool commit, AsyncRequest *req) const = 0;
+
+  virtual void increment(uint64_t id, const std::string &field, const json &delta,
+                         json *result, bool commit, AsyncRequest *req) const = 0;
+
+  virtual void increment_multi(const uint64_t *ids, size_t count,
+                               const std::string &field, const json &delta,
+                               json *result, bool commit, AsyncRequest *req) const = 0;
+};
+
+class Cursor;
+
+/**
+ * @brief Options of a coalescing Collection handle
+ * (see Collection::coalescing).
+ */
+struct CoalescingOptions {
+  size_t max_records = 128;         /* flush once this many records are buffered  */
+  size_t max_bytes   = 1024*1024;   /* flush once buffered records reach this size */
+  double linger_ms   = 1.0;         /* flush this long after the first record      */
+};
+
+/**
+ * @brief Options of a combining Collection handle
+ * (see Collection::combining).
+ */
+struct CombiningOptions {
+  size_t max_records = 128;         /* send once this many records are requested */
+  double linger_ms   = 0.1;         /* send this long after the first request    */
 };
 
 /**
  * @brief The Collection object is a handle to a collection
  * in a given remote database on a server. It offers function
  * to store and search documents.
+ *
+ * Multi-record operations on large batches are split by the backend
+ * into chunks, sized from the documents, that are sent concurrently
+ * and whose results are reassembled in order. A store_multi split in
+ * chunks still stores all or none of the records: if a chunk fails,
+ * the chunks already stored are erased before the error is reported.
+ * Other clients may however see the records of these chunks in the
+ * meantime, and ids are only increasing within a chunk.
  */
 class Collection : public AbstractCollectionImpl {
 
@@ -174,6 +317,75 @@ public:
     } catch(const std::exception& ex) { throw Exception(ex.what()); }
   }
 
+  /**
+   * @brief Returns a handle to the same collection that buffers
+   * the documents passed to store() and store_async() and sends them
+   * as store_multi RPCs. A batch is sent once it reaches
+   * options.max_records documents or options.max_bytes bytes, or
+   * options.linger_ms milliseconds after its first document was
+   * buffered. Each store still completes with its own record id, once
+   * its batch is stored. Other operations go directly to the collection.
+   * Buffered documents are sent when the last copy of the returned
+   * handle is destroyed.
+   *
+   * @param options Batching thresholds.
+   *
+   * @return A coalescing handle to the collection.
+   */
+  Collection coalescing(const CoalescingOptions& options = CoalescingOptions{}) const;
+
+  /**
+   * @brief Returns a handle to the same collection that combines the
+   * fetches of single records issued through it by concurrent ULTs
+   * (fetch(), fetch_async() and fetch_json_async()) into fetch_multi
+   * RPCs. A combined fetch is sent once options.max_records distinct
+   * records are requested, or options.linger_ms milliseconds after the
+   * first request. Each caller receives its own document, or an
+   * exception if the record does not exist. Other operations go
+   * directly to the collection.
+   *
+   * @param options Combining thresholds.
+   *
+   * @return A combining handle to the collection.
+   */
+  Collection combining(const CombiningOptions& options = CombiningOptions{}) const;
+
+  /**
+   * @brief Returns a read-only handle to the collection whose documents
+   * are served from a local file mapped in memory. If the file does not
+   * exist (or, when validate is true, if its number of documents or
+   * last record id differ from the collection's), all the documents
+   * are fetched once and written to the file, so that later handles,
+   * including in other processes, map it instead of fetching them.
+   * Fetches and iterations then complete without RPCs. Filters are
+   * sent to the collection, and writes throw an Exception.
+   * This is meant for collections that are no longer modified.
+   *
+   * @param path Path of the cache file.
+   * @param validate Whether to check the file against the collection.
+   *
+   * @return A read-only handle to the collection.
+   */
+  Collection mapped(const std::string& path, bool validate = true) const;
+
+  /**
+   * @brief Returns a Cursor over the documents whose record ids are in
+   * [start_id, end_id), which fetches batches of batch_size record ids
+   * and prefetches the next batch while the current one is consumed.
+   * If end_id is not provided, the cursor stops after the last record
+   * id of the collection at the time the cursor is created.
+   * Include <isonata/Cursor.hpp> to use the returned Cursor.
+   *
+   * @param start_id First record id.
+   * @param end_id Record id past the last one.
+   * @param batch_size Number of record ids per fetch_multi.
+   *
+   * @return A Cursor positioned on the first document.
+   */
+  Cursor cursor(uint64_t start_id = 0,
+                uint64_t end_id = std::numeric_limits<uint64_t>::max(),
+                size_t batch_size = 128) const;
+
   /**
    * @brief Stores a document into the collection.
    *
@@ -278,7 +490,8 @@ public:
    * should be a pointer to a memory region sufficiently large to
    * store the resulting records.size() identifiers.
    *
-   * This function will either store all or none of the records.
+   * This function will either store all or none of the records
+   * (see above for large batches).
    *
    * @param records Vector of records to store.
    * @param ids Resulting ids.
@@ -298,7 +511,8 @@ public:
    * should be a pointer to a memory region sufficiently large to
    * store the resulting records.size() identifiers.
    *
-   * This function will either store all or none of the records.
+   * This function will either store all or none of the records
+   * (see above for large batches).
    *
    * @param records JSON array of records to store.
    * @param ids Resulting ids.
@@ -319,7 +533,8 @@ public:
    * should be a pointer to a memory region sufficiently large to store the
    * resulting count identifiers.
    *
-   * This function will either store all or none of the records.
+   * This function will either store all or none of the records
+   * (see above for large batches).
    *
    * @param records Vector of records to store.
    * @param count Number of records to store.
@@ -334,6 +549,51 @@ public:
     } catch(const std::exception& ex) { throw Exception(ex.what()); }
   }
 
+  /**
+   * @brief Stores multiple records held in a single packed buffer:
+   * the i-th record has size sizes[i] and starts right after the
+   * (i-1)-th record. The records are sent without being copied
+   * individually.
+   *
+   * This function will either store all or none of the records
+   * (see above for large batches).
+   *
+   * @param data Packed buffer of records.
+   * @param sizes Size of each record.
+   * @param count Number of records to store.
+   * @param ids Resulting ids.
+   * @param commit Whether to commit the changes to storage.
+   * @param req Pointer to a request to wait on.
+   */
+  void store_multi(const char *data, const size_t *sizes, size_t count,
+                   uint64_t *ids, bool commit = false,
+                   AsyncRequest *req = nullptr) const override {
+    try {
+      self->store_multi(data, sizes, count, ids, commit, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Stores multiple records given as an array of views.
+   * The records are sent without being copied individually.
+   *
+   * This function will either store all or none of the records
+   * (see above for large batches).
+   *
+   * @param records Array of records to store.
+   * @param count Number of records to store.
+   * @param ids Resulting ids.
+   * @param commit Whether to commit the changes to storage.
+   * @param req Pointer to a request to wait on.
+   */
+  void store_multi(const std::string_view *records, size_t count,
+                   uint64_t *ids, bool commit = false,
+                   AsyncRequest *req = nullptr) const override {
+    try {
+      self->store_multi(records, count, ids, commit, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
   /**
    * @brief Asynchronously fetches a document by its record id.
    * If req is null, this function becomes synchronous.
@@ -397,6 +657,25 @@ public:
     } catch(const std::exception& ex) { throw Exception(ex.what()); }
   }
 
+  /**
+   * @brief Asynchronously fetches multiple documents by their record id
+   * into a DocumentBatch. The batch is cleared first, but its memory is
+   * reused. Records that do not exist are skipped; use
+   * DocumentBatch::id to know which record each document comes from.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param[in] ids Array of record ids.
+   * @param[in] count Number of records.
+   * @param[out] result Resulting batch of documents.
+   * @param req Pointer to a request to wait on.
+   */
+  void fetch_multi(const uint64_t *ids, size_t count, DocumentBatch *result,
+                   AsyncRequest *req = nullptr) const override {
+    try {
+      self->fetch_multi(ids, count, result, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
   /**
    * @brief Asynchronously filters the collection and returns the
    * records that match the condition. This condition should
@@ -406,9 +685,14 @@ public:
    *
    * "function($record) { return $record.x < 4; }"
    *
+   * With the Yokan backend, the condition is instead a Lua script
+   * evaluated by the provider (Yokan must be built with Lua support),
+   * in which the document is available as __doc__ and its record id
+   * as __id__. Only matching records are sent back, page by page.
+   *
    * If req is null, this function becomes synchronous.
    *
-   * @param filterCode A Jx9 filter code.
+   * @param filterCode A Jx9 (Sonata) or Lua (Yokan) filter code.
    * @param result Resuling vector of records as strings.
    * @param req Pointer to a request to wait on.
    */
@@ -428,9 +712,14 @@ public:
    *
    * "function($record) { return $record.x < 4; }"
    *
+   * With the Yokan backend, the condition is instead a Lua script
+   * evaluated by the provider (Yokan must be built with Lua support),
+   * in which the document is available as __doc__ and its record id
+   * as __id__. Only matching records are sent back, page by page.
+   *
    * If req is null, this function becomes synchronous.
    *
-   * @param filterCode A Jx9 filter code.
+   * @param filterCode A Jx9 (Sonata) or Lua (Yokan) filter code.
    * @param result Resuling JSON object containing the array of results.
    * @param req Pointer to a request to wait on.
    */
@@ -441,6 +730,22 @@ public:
     } catch(const std::exception& ex) { throw Exception(ex.what()); }
   }
 
+  /**
+   * @brief Same as the above filter functions, but the matching
+   * records are placed in a DocumentBatch, which is cleared first
+   * but whose memory is reused.
+   *
+   * @param filterCode A Jx9 (Sonata) or Lua (Yokan) filter code.
+   * @param result Resulting batch of documents.
+   * @param req Pointer to a request to wait on.
+   */
+  void filter(const std::string &filterCode, DocumentBatch *result,
+              AsyncRequest *req = nullptr) const override {
+    try {
+      self->filter(filterCode, result, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
   /**
    * @brief Asynchronously updates the content of a document with a new content.
    * If req is null, this function becomes synchronous.
@@ -549,6 +854,53 @@ public:
     } catch(const std::exception& ex) { throw Exception(ex.what()); }
   }
 
+  /**
+   * @brief Asynchronously updates multiple documents whose new contents
+   * are held in a single packed buffer: the i-th record has size sizes[i]
+   * and starts right after the (i-1)-th record. The records are sent
+   * without being copied individually.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param ids Record ids of the documents to update.
+   * @param data Packed buffer of new documents.
+   * @param sizes Size of each new document.
+   * @param count Number of documents to update.
+   * @param updated Pointer to a vector that will contain whether
+   *                each record was updated.
+   * @param commit Whether to commit the changes to storage.
+   * @param req Pointer to a request to wait on.
+   */
+  void update_multi(const uint64_t *ids, const char *data,
+                    const size_t *sizes, size_t count,
+                    std::vector<bool> *updated, bool commit = false,
+                    AsyncRequest *req = nullptr) const override {
+    try {
+      self->update_multi(ids, data, sizes, count, updated, commit, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Asynchronously updates multiple documents whose new contents
+   * are given as an array of views. The records are sent without being
+   * copied individually.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param ids Record ids of the documents to update.
+   * @param records New documents.
+   * @param count Number of documents to update.
+   * @param updated Pointer to a vector that will contain whether
+   *                each record was updated.
+   * @param commit Whether to commit the changes to storage.
+   * @param req Pointer to a request to wait on.
+   */
+  void update_multi(const uint64_t *ids, const std::string_view *records,
+                    size_t count, std::vector<bool> *updated, bool commit = false,
+                    AsyncRequest *req = nullptr) const override {
+    try {
+      self->update_multi(ids, records, count, updated, commit, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
   /**
    * @brief Asynchronously returns all the documents from the collection
    * as a vector of strings.
@@ -577,6 +929,148 @@ public:
     } catch(const std::exception& ex) { throw Exception(ex.what()); }
   }
 
+  /**
+   * @brief Asynchronously returns all the documents from the collection
+   * in a DocumentBatch, which is cleared first but whose memory is reused.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param result All the documents from the collection.
+   * @param req Pointer to a request to wait on.
+   */
+  void all(DocumentBatch *result, AsyncRequest *req = nullptr) const override {
+    try {
+      self->all(result, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Asynchronously iterates over all the documents of the
+   * collection, handing them to the callback in batches of at most
+   * batch_size documents. Only one batch is held in memory at a time.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param callback Function called on each batch of documents.
+   * @param batch_size Maximum number of documents per batch.
+   * @param req Pointer to a request to wait on.
+   */
+  void all(const std::function<void(const std::vector<std::string>&)> &callback,
+           size_t batch_size = 128, AsyncRequest *req = nullptr) const override {
+    try {
+      self->all(callback, batch_size, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Asynchronously stores a document, taking ownership of it.
+   * The caller does not need to keep the record alive, and the
+   * resulting record id is obtained from the returned AsyncResult.
+   *
+   * @param record A valid JSON-formated document.
+   * @param commit Whether to commit the change to storage.
+   *
+   * @return An AsyncResult holding the record id.
+   */
+  AsyncResult<uint64_t> store_async(std::string &&record,
+                                    bool commit = false) const override {
+    try {
+      return self->store_async(std::move(record), commit);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Same as above with a JSON document.
+   *
+   * @param record A JSON document.
+   * @param commit Whether to commit the change to storage.
+   *
+   * @return An AsyncResult holding the record id.
+   */
+  AsyncResult<uint64_t> store_async(json &&record,
+                                    bool commit = false) const override {
+    try {
+      return self->store_async(std::move(record), commit);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Asynchronously stores multiple documents, taking
+   * ownership of them.
+   *
+   * This function will either store all or none of the records
+   * (see above for large batches).
+   *
+   * @param records Vector of records to store.
+   * @param commit Whether to commit the change to storage.
+   *
+   * @return An AsyncResult holding the record ids.
+   */
+  AsyncResult<std::vector<uint64_t>> store_multi_async(
+        std::vector<std::string> &&records, bool commit = false) const override {
+    try {
+      return self->store_multi_async(std::move(records), commit);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Asynchronously fetches a document by its record id.
+   *
+   * @param id Record id.
+   *
+   * @return An AsyncResult holding the document.
+   */
+  AsyncResult<std::string> fetch_async(uint64_t id) const override {
+    try {
+      return self->fetch_async(id);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Asynchronously fetches a document by its record id
+   * and parses it as a JSON object.
+   *
+   * @param id Record id.
+   *
+   * @return An AsyncResult holding the JSON document.
+   */
+  AsyncResult<json> fetch_json_async(uint64_t id) const override {
+    try {
+      return self->fetch_json_async(id);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Asynchronously updates a document, taking ownership
+   * of its new content.
+   *
+   * @param id Record id of the document to update.
+   * @param record New document.
+   * @param commit Whether to commit the change to storage.
+   *
+   * @return An AsyncResult to wait on.
+   */
+  AsyncResult<void> update_async(uint64_t id, std::string &&record,
+                                 bool commit = false) const override {
+    try {
+      return self->update_async(id, std::move(record), commit);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Same as above with a JSON document.
+   *
+   * @param id Record id of the document to update.
+   * @param record New document.
+   * @param commit Whether to commit the change to storage.
+   *
+   * @return An AsyncResult to wait on.
+   */
+  AsyncResult<void> update_async(uint64_t id, json &&record,
+                                 bool commit = false) const override {
+    try {
+      return self->update_async(id, std::move(record), commit);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
   /**
    * @brief Returns the last record id used by the collection.
    *
@@ -630,6 +1124,221 @@ public:
       return self->erase_multi(ids, size, commit, req);
     } catch(const std::exception& ex) { throw Exception(ex.what()); }
   }
+
+  /**
+   * @brief Fetches the documents whose record ids are in
+   * [first, first+count), in increasing id order, skipping the ids
+   * of erased records. No array of ids is sent to the provider.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param first First record id.
+   * @param count Number of record ids in the range.
+   * @param result Resulting documents.
+   * @param req Pointer to a request to wait on.
+   */
+  void fetch_range(uint64_t first, size_t count, DocumentBatch *result,
+                   AsyncRequest *req = nullptr) const override {
+    try {
+      return self->fetch_range(first, count, result, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Same as above, returning the documents as strings.
+   *
+   * @param first First record id.
+   * @param count Number of record ids in the range.
+   * @param result Resulting documents.
+   * @param req Pointer to a request to wait on.
+   */
+  void fetch_range(uint64_t first, size_t count, std::vector<std::string> *result,
+                   AsyncRequest *req = nullptr) const override {
+    try {
+      return self->fetch_range(first, count, result, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Erases the documents whose record ids are in
+   * [first, first+count). Ids of records that do not exist are
+   * skipped. The range is processed in bounded chunks, so erasing
+   * a large range does not require a large array of ids.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param first First record id.
+   * @param count Number of record ids in the range.
+   * @param commit Whether to commit the changes to storage.
+   * @param req Pointer to a request to wait on.
+   */
+  void erase_range(uint64_t first, size_t count, bool commit = false,
+                   AsyncRequest *req = nullptr) const override {
+    try {
+      return self->erase_range(first, count, commit, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Fetches only some fields of a document. Each field is a
+   * JSON pointer such as "/position/x", or the name of a top-level
+   * field. The result keeps each field at its path and omits the
+   * fields that the document does not have. The document is reduced
+   * by the provider, so only the selected fields are transferred
+   * (see fetch_multi below for the exceptions).
+   * If req is null, this function becomes synchronous.
+   *
+   * @param[in] id Record id.
+   * @param[in] fields Fields to fetch.
+   * @param[out] result Resulting JSON object.
+   * @param req Pointer to a request to wait on.
+   */
+  void fetch(uint64_t id, const std::vector<std::string> &fields,
+             json *result, AsyncRequest *req = nullptr) const override {
+    try {
+      self->fetch(id, fields, result, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Fetches only some fields of multiple documents, as above.
+   * With Sonata, the documents are reduced by a Jx9 script run by the
+   * provider. With Yokan, they are reduced by a document filter that
+   * the ISonata provider registers, except in compressed collections,
+   * whose documents are reduced on the client, as are documents served
+   * by a Yokan provider that does not have that filter.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param[in] ids Record ids.
+   * @param[in] count Number of records to fetch.
+   * @param[in] fields Fields to fetch.
+   * @param[out] result Resulting JSON array.
+   * @param req Pointer to a request to wait on.
+   */
+  void fetch_multi(const uint64_t *ids, size_t count,
+                   const std::vector<std::string> &fields,
+                   json *result, AsyncRequest *req = nullptr) const override {
+    try {
+      self->fetch_multi(ids, count, fields, result, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Filters the collection as the filter functions above do,
+   * returning only some fields of the matching records (see fetch).
+   * With Yokan, the provider cannot run a Lua filter and reduce the
+   * documents in the same request, so documents are only reduced by
+   * the provider when filterCode is empty (selecting all records).
+   * If req is null, this function becomes synchronous.
+   *
+   * @param filterCode A Jx9 (Sonata) or Lua (Yokan) filter code.
+   * @param fields Fields to fetch.
+   * @param result Resulting JSON array.
+   * @param req Pointer to a request to wait on.
+   */
+  void filter(const std::string &filterCode, const std::vector<std::string> &fields,
+              json *result, AsyncRequest *req = nullptr) const override {
+    try {
+      self->filter(filterCode, fields, result, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Modifies a document without sending its whole content: the
+   * patch is either a JSON Patch (RFC 6902), i.e. an array of
+   * operations, or a JSON Merge Patch (RFC 7386), i.e. an object whose
+   * fields replace those of the document, null fields removing them.
+   * With Sonata, merge patches are applied by a Jx9 script run by the
+   * provider, and JSON Patches by the client. With Yokan, patches are
+   * applied by the ISonata provider, except in compressed collections,
+   * whose documents are patched by the client. Documents patched by
+   * the client are written back only if no other client modified them
+   * in the meantime, the patch being retried otherwise. Patching a record that
+   * does not exist, or a JSON Patch whose "test" operation fails,
+   * throws an exception.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param id Record id of the document to patch.
+   * @param patch JSON Patch or JSON Merge Patch.
+   * @param commit Whether to commit the changes to storage.
+   * @param req Pointer to a request to wait on.
+   */
+  void patch(uint64_t id, const json &patch, bool commit = false,
+             AsyncRequest *req = nullptr) const override {
+    try {
+      self->patch(id, patch, commit, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Applies the same patch (see above) to multiple documents.
+   * Large requests are split into chunks: if patching a document of a
+   * chunk fails, that chunk is left unmodified but the documents of
+   * other chunks may have been patched.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param ids Record ids of the documents to patch.
+   * @param count Number of documents to patch.
+   * @param patch JSON Patch or JSON Merge Patch.
+   * @param commit Whether to commit the changes to storage.
+   * @param req Pointer to a request to wait on.
+   */
+  void patch_multi(const uint64_t *ids, size_t count, const json &patch,
+                   bool commit = false, AsyncRequest *req = nullptr) const override {
+    try {
+      self->patch_multi(ids, count, patch, commit, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Atomically adds delta to a numeric field of a document on
+   * the provider and returns the new value. The field is a JSON pointer
+   * or the name of a top-level field, as in fetch; a missing field
+   * counts as 0. Adding two integers gives an integer, or throws an
+   * exception if the sum does not fit in 64 bits.
+   * With Sonata, the increment is a Jx9 script. With Yokan, it is
+   * applied by the ISonata provider, which serializes the increments
+   * and patches of a record, but not the updates of the same record;
+   * compressed collections do not support increments.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param[in] id Record id.
+   * @param[in] field Field to increment.
+   * @param[in] delta Number to add.
+   * @param[out] result New value of the field.
+   * @param[in] commit Whether to commit the changes to storage.
+   * @param req Pointer to a request to wait on.
+   */
+  void increment(uint64_t id, const std::string &field, const json &delta,
+                 json *result = nullptr, bool commit = false,
+                 AsyncRequest *req = nullptr) const override {
+    try {
+      self->increment(id, field, delta, result, commit, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
+  /**
+   * @brief Increments the same field of multiple documents (see
+   * above), returning the new values as a JSON array. A repeated id
+   * is incremented once per occurrence. As with patch_multi, large
+   * requests are split into chunks, and a chunk
+   * containing a record that cannot be incremented is left unmodified.
+   * If req is null, this function becomes synchronous.
+   *
+   * @param[in] ids Record ids.
+   * @param[in] count Number of records.
+   * @param[in] field Field to increment.
+   * @param[in] delta Number to add.
+   * @param[out] result Resulting JSON array of new values.
+   * @param[in] commit Whether to commit the changes to storage.
+   * @param req Pointer to a request to wait on.
+   */
+  void increment_multi(const uint64_t *ids, size_t count,
+                       const std::string &field, const json &delta,
+                       json *result = nullptr, bool commit = false,
+                       AsyncRequest *req = nullptr) const override {
+    try {
+      self->increment_multi(ids, count, field, delta, result, commit, req);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
 };
 } // namespace isonata
 
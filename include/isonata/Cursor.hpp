@@ -0,0 +1,212 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_CURSOR_HPP
+#define __ISONATA_CURSOR_HPP
+
+#include <isonata/Collection.hpp>
+#include <isonata/DocumentBatch.hpp>
+#include <isonata/AsyncRequest.hpp>
+#include <isonata/Exception.hpp>
+#include <nlohmann/json.hpp>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace isonata {
+
+using nlohmann::json;
+
+/**
+ * @brief A Cursor iterates over the documents of a collection whose
+ * record ids are in [start_id, end_id), in increasing id order. It
+ * fetches the documents in batches of record ids with fetch_multi,
+ * and requests the next batch while the caller consumes the current
+ * one, so that the network transfer of a batch overlaps with the
+ * processing of the previous one. Ids of erased records are skipped.
+ *
+ * Cursors are created by Collection::cursor. They can be moved but
+ * not copied.
+ */
+class Cursor {
+
+  struct State {
+    Collection            coll;
+    uint64_t              next_id;
+    uint64_t              end_id;
+    size_t                batch_size;
+    std::vector<uint64_t> ids;
+    DocumentBatch         current;
+    DocumentBatch         next;
+    AsyncRequest          next_req;
+    bool                  next_pending = false;
+    size_t                pos = 0;
+    json                  parsed;
+    bool                  is_parsed = false;
+  };
+
+  std::unique_ptr<State> m_state;
+
+  void prefetch() {
+    auto& s = *m_state;
+    if(s.next_id >= s.end_id) return;
+    const auto count = std::min<uint64_t>(s.batch_size, s.end_id - s.next_id);
+    s.ids.resize(count);
+    for(size_t i = 0; i < count; ++i) s.ids[i] = s.next_id + i;
+    s.next_id += count;
+    s.coll.fetch_multi(s.ids.data(), count, &s.next, &s.next_req);
+    s.next_pending = true;
+  }
+
+  void drain() {
+    if(m_state && m_state->next_pending) {
+      m_state->next_pending = false;
+      try { m_state->next_req.wait(); } catch(...) {}
+    }
+  }
+
+  void advance() {
+    auto& s = *m_state;
+    s.is_parsed = false;
+    while(s.pos >= s.current.size() && s.next_pending) {
+      s.next_pending = false;
+      s.next_req.wait();
+      std::swap(s.current, s.next);
+      s.pos = 0;
+      prefetch();
+    }
+  }
+
+public:
+
+  /**
+   * @brief Input iterator over the documents of the cursor. Each
+   * element is the cursor itself, positioned on the document.
+   */
+  class iterator {
+
+    Cursor* m_cursor = nullptr;
+
+  public:
+
+    using iterator_category = std::input_iterator_tag;
+    using value_type        = Cursor;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const Cursor*;
+    using reference         = const Cursor&;
+
+    iterator() = default;
+
+    explicit iterator(Cursor* cursor)
+    : m_cursor(cursor && *cursor ? cursor : nullptr) {}
+
+    const Cursor& operator*() const { return *m_cursor; }
+
+    const Cursor* operator->() const { return m_cursor; }
+
+    iterator& operator++() {
+      m_cursor->next();
+      if(!*m_cursor) m_cursor = nullptr;
+      return *this;
+    }
+
+    bool operator==(const iterator& other) const { return m_cursor == other.m_cursor; }
+
+    bool operator!=(const iterator& other) const { return m_cursor != other.m_cursor; }
+  };
+
+  /**
+   * @brief Constructor. Issues the first fetch_multi.
+   *
+   * @param coll Collection to iterate over.
+   * @param start_id First record id.
+   * @param end_id Record id past the last one.
+   * @param batch_size Number of record ids requested per fetch_multi.
+   */
+  Cursor(Collection coll, uint64_t start_id, uint64_t end_id, size_t batch_size)
+  : m_state(new State{std::move(coll), start_id, end_id, batch_size ? batch_size : 1}) {
+    prefetch();
+    advance();
+  }
+
+  Cursor(Cursor&&) = default;
+  Cursor(const Cursor&) = delete;
+  Cursor& operator=(const Cursor&) = delete;
+
+  Cursor& operator=(Cursor&& other) {
+    if(this != &other) {
+      drain();
+      m_state = std::move(other.m_state);
+    }
+    return *this;
+  }
+
+  /**
+   * @brief The destructor waits for the prefetch in flight, if any.
+   */
+  ~Cursor() {
+    drain();
+  }
+
+  /**
+   * @brief Whether the cursor is positioned on a document.
+   */
+  explicit operator bool() const {
+    return m_state && m_state->pos < m_state->current.size();
+  }
+
+  /**
+   * @brief Moves to the next document. Blocks if the next batch has
+   * not arrived yet, and rethrows the error of its fetch_multi, if any.
+   */
+  void next() {
+    if(!*this) throw Exception("Cursor is past the last document");
+    m_state->pos += 1;
+    advance();
+  }
+
+  /**
+   * @brief Record id of the current document.
+   */
+  uint64_t id() const {
+    return m_state->current.id(m_state->pos);
+  }
+
+  /**
+   * @brief Raw bytes of the current document. The view is valid
+   * until the cursor moves to the next batch of documents.
+   */
+  std::string_view data() const {
+    return m_state->current[m_state->pos];
+  }
+
+  /**
+   * @brief Current document parsed as JSON. The document is parsed
+   * on the first call only.
+   */
+  const json& parse() const {
+    if(!m_state->is_parsed) {
+      m_state->parsed = m_state->current.parse(m_state->pos);
+      m_state->is_parsed = true;
+    }
+    return m_state->parsed;
+  }
+
+  /**
+   * @brief Batch of documents containing the current document.
+   */
+  const DocumentBatch& batch() const {
+    return m_state->current;
+  }
+
+  iterator begin() { return iterator{this}; }
+
+  iterator end() { return iterator{}; }
+};
+
+} // namespace isonata
+
+#endif
@@ -29,6 +29,8 @@ public:
 
   virtual Collection create(const std::string &collectionName) const = 0;
 
+  virtual Collection create(const std::string &collectionName, const json &options) const = 0;
+
   virtual bool exists(const std::string &collectionName) const = 0;
 
   virtual Collection open(const std::string &collectionName, bool check = true) const = 0;
@@ -83,6 +85,38 @@ public:
     } catch(const std::exception& ex) { throw Exception(ex.what()); }
   }
 
+  /**
+   * @brief Creates a collection with options. The "format" field
+   * selects the encoding in which the collection stores its documents:
+   * "json" (the default), "cbor", "msgpack" or "bson" (see
+   * DocumentFormat). The format is recorded with the collection, so
+   * open() uses it as well. Documents are encoded and decoded
+   * transparently: the string and DocumentBatch functions of Collection
+   * still exchange JSON text, converted when stored and fetched, while
+   * filters run against the stored encoding.
+   *
+   * The "compression" field compresses each document after encoding
+   * it. It is either the name of the method or an object such as
+   * {"method": "zstd", "level": 3, "dictionary_samples": [...],
+   * "dictionary_size": 16384}. When sample documents are given, a
+   * dictionary is trained on them and recorded with the collection,
+   * which greatly improves the compression of small documents that
+   * share keys and values. The "zstd" method requires ISonata to be
+   * built with ENABLE_ZSTD.
+   *
+   * Only the Yokan backend supports binary formats and compression.
+   *
+   * @param collectionName Name of the collection to create.
+   * @param options JSON object of options.
+   *
+   * @return A valid Collection instance pointing to the new collection.
+   */
+  Collection create(const std::string &collectionName, const json &options) const override {
+    try {
+      return self->create(collectionName, options);
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+  }
+
   /**
    * @brief Checks if a collection exists.
    *
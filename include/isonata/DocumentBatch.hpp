@@ -0,0 +1,205 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_DOCUMENT_BATCH_HPP
+#define __ISONATA_DOCUMENT_BATCH_HPP
+
+#include <isonata/JsonCodec.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <cstring>
+#include <vector>
+
+namespace isonata {
+
+using nlohmann::json;
+
+/**
+ * @brief A DocumentBatch holds a set of documents in a single
+ * contiguous buffer, along with an array of (record id, offset, size)
+ * entries. Calling clear() keeps the allocated memory, so the same
+ * DocumentBatch can be reused across calls without reallocating.
+ */
+class DocumentBatch {
+
+public:
+
+  struct Entry {
+    uint64_t id;
+    size_t   offset;
+    size_t   size;
+  };
+
+  class const_iterator {
+
+    const DocumentBatch* m_batch = nullptr;
+    size_t               m_index = 0;
+
+  public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = std::string_view;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const std::string_view*;
+    using reference         = std::string_view;
+
+    const_iterator() = default;
+
+    const_iterator(const DocumentBatch* batch, size_t index)
+    : m_batch(batch), m_index(index) {}
+
+    std::string_view operator*() const { return (*m_batch)[m_index]; }
+
+    const_iterator& operator++() { ++m_index; return *this; }
+
+    const_iterator operator++(int) { auto it = *this; ++m_index; return it; }
+
+    bool operator==(const const_iterator& other) const {
+      return m_batch == other.m_batch && m_index == other.m_index;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+  };
+
+private:
+
+  std::vector<char>  m_data;
+  size_t             m_used = 0;
+  std::vector<Entry> m_entries;
+
+public:
+
+  DocumentBatch() = default;
+  DocumentBatch(DocumentBatch&&) = default;
+  DocumentBatch(const DocumentBatch&) = default;
+  DocumentBatch& operator=(DocumentBatch&&) = default;
+  DocumentBatch& operator=(const DocumentBatch&) = default;
+  ~DocumentBatch() = default;
+
+  /**
+   * @brief Number of documents in the batch.
+   */
+  size_t size() const { return m_entries.size(); }
+
+  /**
+   * @brief Whether the batch is empty.
+   */
+  bool empty() const { return m_entries.empty(); }
+
+  /**
+   * @brief Total number of bytes used by the documents.
+   */
+  size_t bytes() const { return m_used; }
+
+  /**
+   * @brief Returns a view of the i-th document. The view is
+   * invalidated when documents are added to the batch.
+   */
+  std::string_view operator[](size_t i) const {
+    const auto& e = m_entries[i];
+    return std::string_view{m_data.data() + e.offset, e.size};
+  }
+
+  /**
+   * @brief Returns the record id of the i-th document.
+   */
+  uint64_t id(size_t i) const { return m_entries[i].id; }
+
+  /**
+   * @brief Parses the i-th document into a JSON object
+   * with the current JsonCodec.
+   */
+  json parse(size_t i) const {
+    return JsonCodec::current().parse((*this)[i]);
+  }
+
+  /**
+   * @brief Returns the array of entries.
+   */
+  const std::vector<Entry>& entries() const { return m_entries; }
+
+  /**
+   * @brief Pointer to the underlying buffer.
+   */
+  const char* data() const { return m_data.data(); }
+
+  const_iterator begin() const { return const_iterator{this, 0}; }
+
+  const_iterator end() const { return const_iterator{this, m_entries.size()}; }
+
+  /**
+   * @brief Removes all the documents, keeping the allocated memory.
+   */
+  void clear() {
+    m_used = 0;
+    m_entries.clear();
+  }
+
+  /**
+   * @brief Reserves memory for the given number of documents
+   * and bytes.
+   */
+  void reserve(size_t count, size_t bytes) {
+    m_entries.reserve(count);
+    if(m_data.size() < bytes) m_data.resize(bytes);
+  }
+
+  /**
+   * @brief Copies a document at the end of the batch.
+   */
+  void push_back(uint64_t id, const char* data, size_t size) {
+    std::memcpy(write_area(size), data, size);
+    add(id, append_bytes(size), size);
+  }
+
+  /**
+   * @brief Copies all the documents of another batch at the end of
+   * this batch, preserving their order.
+   */
+  void append(const DocumentBatch& other) {
+    std::memcpy(write_area(other.m_used), other.m_data.data(), other.m_used);
+    const auto base = append_bytes(other.m_used);
+    m_entries.reserve(m_entries.size() + other.m_entries.size());
+    for(const auto& e : other.m_entries) add(e.id, base + e.offset, e.size);
+  }
+
+  /**
+   * @brief Returns a pointer to at least bytes bytes of free memory
+   * at the end of the buffer. This function, together with
+   * append_bytes and add, lets backends write documents directly into
+   * the batch. The pointer is invalidated by any other call that
+   * adds data to the batch.
+   */
+  char* write_area(size_t bytes) {
+    if(m_data.size() < m_used + bytes)
+      m_data.resize(std::max(m_used + bytes, 2*m_data.size()));
+    return m_data.data() + m_used;
+  }
+
+  /**
+   * @brief Marks bytes bytes of the write area as used and returns
+   * the offset at which they start.
+   */
+  size_t append_bytes(size_t bytes) {
+    auto offset = m_used;
+    m_used += bytes;
+    return offset;
+  }
+
+  /**
+   * @brief Registers a document already written in the buffer.
+   */
+  void add(uint64_t id, size_t offset, size_t size) {
+    m_entries.push_back(Entry{id, offset, size});
+  }
+};
+
+} // namespace isonata
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_DOCUMENT_CACHE_HPP
+#define __ISONATA_DOCUMENT_CACHE_HPP
+
+#include <thallium.hpp>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief A DocumentCache is a memory-bounded LRU cache of raw
+ * documents, keyed by a scope (identifying the provider, database
+ * and collection) and a record id. It is safe to use from multiple
+ * ULTs. See Client::cached for how to attach it to a Client.
+ *
+ * Invalidations increment an epoch, so that a document read before
+ * an invalidation can be inserted only if no invalidation happened
+ * since the read started (see insert).
+ */
+class DocumentCache {
+
+  struct Key {
+    std::string scope;
+    uint64_t    id;
+
+    bool operator==(const Key& other) const {
+      return id == other.id && scope == other.scope;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return std::hash<std::string>()(key.scope) ^ (std::hash<uint64_t>()(key.id) << 1);
+    }
+  };
+
+  struct Entry {
+    Key         key;
+    std::string data;
+  };
+
+  size_t                                                 m_capacity;
+  size_t                                                 m_bytes = 0;
+  uint64_t                                               m_epoch = 0;
+  size_t                                                 m_hits = 0;
+  size_t                                                 m_misses = 0;
+  std::list<Entry>                                       m_lru;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_index;
+  mutable tl::mutex                                      m_mutex;
+
+  void evict() {
+    while(m_bytes > m_capacity && !m_lru.empty()) {
+      auto& victim = m_lru.back();
+      m_bytes -= victim.data.size();
+      m_index.erase(victim.key);
+      m_lru.pop_back();
+    }
+  }
+
+  void remove(const Key& key) {
+    auto it = m_index.find(key);
+    if(it == m_index.end()) return;
+    m_bytes -= it->second->data.size();
+    m_lru.erase(it->second);
+    m_index.erase(it);
+  }
+
+  void put(Key&& key, std::string_view data) {
+    if(data.size() > m_capacity) {
+      remove(key);
+      return;
+    }
+    auto it = m_index.find(key);
+    if(it != m_index.end()) {
+      m_bytes -= it->second->data.size();
+      it->second->data.assign(data);
+      m_lru.splice(m_lru.begin(), m_lru, it->second);
+    } else {
+      m_lru.push_front(Entry{key, std::string{data}});
+      m_index.emplace(std::move(key), m_lru.begin());
+    }
+    m_bytes += data.size();
+    evict();
+  }
+
+public:
+
+  /**
+   * @brief Constructor.
+   *
+   * @param capacity Maximum number of document bytes held by the cache.
+   */
+  explicit DocumentCache(size_t capacity)
+  : m_capacity(capacity) {}
+
+  DocumentCache(const DocumentCache&) = delete;
+  DocumentCache& operator=(const DocumentCache&) = delete;
+
+  /**
+   * @brief Looks up a document, counting a hit or a miss.
+   *
+   * @param scope Scope of the document.
+   * @param id Record id.
+   * @param data Resulting document, if found.
+   *
+   * @return Whether the document was found.
+   */
+  bool get(const std::string& scope, uint64_t id, std::string* data) {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    auto it = m_index.find(Key{scope, id});
+    if(it == m_index.end()) {
+      m_misses += 1;
+      return false;
+    }
+    m_hits += 1;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    if(data) *data = it->second->data;
+    return true;
+  }
+
+  /**
+   * @brief Inserts or replaces a document.
+   */
+  void put(const std::string& scope, uint64_t id, std::string_view data) {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    put(Key{scope, id}, data);
+  }
+
+  /**
+   * @brief Inserts or replaces a document if no invalidation happened
+   * since epoch() returned the provided value.
+   *
+   * @return Whether the document was inserted.
+   */
+  bool insert(const std::string& scope, uint64_t id, std::string_view data,
+              uint64_t epoch) {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    if(epoch != m_epoch) return false;
+    put(Key{scope, id}, data);
+    return true;
+  }
+
+  /**
+   * @brief Removes a document.
+   */
+  void erase(const std::string& scope, uint64_t id) {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    m_epoch += 1;
+    remove(Key{scope, id});
+  }
+
+  /**
+   * @brief Removes the documents with ids in [first, first+count).
+   */
+  void erase_range(const std::string& scope, uint64_t first, uint64_t count) {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    m_epoch += 1;
+    if(count <= m_lru.size()) {
+      for(uint64_t i = 0; i < count; ++i) remove(Key{scope, first + i});
+      return;
+    }
+    for(auto it = m_lru.begin(); it != m_lru.end();) {
+      if(it->key.scope == scope && it->key.id >= first && it->key.id - first < count) {
+        m_bytes -= it->data.size();
+        m_index.erase(it->key);
+        it = m_lru.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  /**
+   * @brief Removes all the documents whose scope starts with the prefix.
+   */
+  void erase_prefix(const std::string& prefix) {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    m_epoch += 1;
+    for(auto it = m_lru.begin(); it != m_lru.end();) {
+      if(it->key.scope.compare(0, prefix.size(), prefix) == 0) {
+        m_bytes -= it->data.size();
+        m_index.erase(it->key);
+        it = m_lru.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  /**
+   * @brief Removes all the documents.
+   */
+  void clear() {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    m_epoch += 1;
+    m_index.clear();
+    m_lru.clear();
+    m_bytes = 0;
+  }
+
+  /**
+   * @brief Current invalidation epoch.
+   */
+  uint64_t epoch() const {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    return m_epoch;
+  }
+
+  /**
+   * @brief Number of lookups that found their document.
+   */
+  size_t hits() const {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    return m_hits;
+  }
+
+  /**
+   * @brief Number of lookups that did not find their document.
+   */
+  size_t misses() const {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    return m_misses;
+  }
+
+  /**
+   * @brief Resets the hit and miss counters.
+   */
+  void reset_counters() {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    m_hits = m_misses = 0;
+  }
+
+  /**
+   * @brief Number of documents in the cache.
+   */
+  size_t size() const {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    return m_lru.size();
+  }
+
+  /**
+   * @brief Number of document bytes in the cache.
+   */
+  size_t bytes() const {
+    std::unique_lock<tl::mutex> lock{m_mutex};
+    return m_bytes;
+  }
+
+  /**
+   * @brief Maximum number of document bytes in the cache.
+   */
+  size_t capacity() const {
+    return m_capacity;
+  }
+};
+
+} // namespace isonata
+
+#endif
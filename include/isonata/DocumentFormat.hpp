@@ -0,0 +1,102 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_DOCUMENT_FORMAT_HPP
+#define __ISONATA_DOCUMENT_FORMAT_HPP
+
+#include <isonata/JsonCodec.hpp>
+#include <isonata/Exception.hpp>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+
+namespace isonata {
+
+using nlohmann::json;
+
+/**
+ * @brief Encoding in which a collection stores its documents. Binary
+ * encodings are usually much smaller than JSON text for numeric data
+ * and faster to produce and read back. BSON can only encode documents
+ * that are JSON objects.
+ */
+enum class DocumentFormat {
+  JSON,
+  CBOR,
+  MessagePack,
+  BSON
+};
+
+/**
+ * @brief Name of the format, as accepted in the "format" field of
+ * the options of Database::create.
+ */
+inline std::string format_name(DocumentFormat format) {
+  switch(format) {
+    case DocumentFormat::CBOR:        return "cbor";
+    case DocumentFormat::MessagePack: return "msgpack";
+    case DocumentFormat::BSON:        return "bson";
+    default:                          return "json";
+  }
+}
+
+/**
+ * @brief Returns the format with the given name.
+ * Throws an Exception if there is none.
+ */
+inline DocumentFormat parse_format(std::string_view name) {
+  if(name == "json")    return DocumentFormat::JSON;
+  if(name == "cbor")    return DocumentFormat::CBOR;
+  if(name == "msgpack") return DocumentFormat::MessagePack;
+  if(name == "bson")    return DocumentFormat::BSON;
+  throw Exception{"Unknown document format \"" + std::string{name} + "\""};
+}
+
+/**
+ * @brief Returns the format selected by the "format" field of the
+ * options of Database::create, JSON if there is none.
+ */
+inline DocumentFormat format_option(const json& options) {
+  if(!options.is_object() || !options.contains("format"))
+    return DocumentFormat::JSON;
+  const auto& format = options["format"];
+  if(!format.is_string())
+    throw Exception{"\"format\" field in collection options should be a string"};
+  return parse_format(format.get_ref<const std::string&>());
+}
+
+/**
+ * @brief Encodes the value in the given format into out, replacing
+ * its content. JSON text is produced by the current JsonCodec.
+ */
+inline void encode(DocumentFormat format, const json& value, std::string& out) {
+  if(format == DocumentFormat::JSON) {
+    JsonCodec::current().dump(value, out);
+    return;
+  }
+  out.clear();
+  switch(format) {
+    case DocumentFormat::CBOR:        json::to_cbor(value, out); break;
+    case DocumentFormat::MessagePack: json::to_msgpack(value, out); break;
+    default:                          json::to_bson(value, out); break;
+  }
+}
+
+/**
+ * @brief Decodes a document stored in the given format.
+ * Throws an exception if the document is not valid.
+ */
+inline json decode(DocumentFormat format, std::string_view doc) {
+  switch(format) {
+    case DocumentFormat::CBOR:        return json::from_cbor(doc.begin(), doc.end());
+    case DocumentFormat::MessagePack: return json::from_msgpack(doc.begin(), doc.end());
+    case DocumentFormat::BSON:        return json::from_bson(doc.begin(), doc.end());
+    default:                          return JsonCodec::current().parse(doc);
+  }
+}
+
+} // namespace isonata
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_JSON_CODEC_HPP
+#define __ISONATA_JSON_CODEC_HPP
+
+#include <nlohmann/json.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace isonata {
+
+using nlohmann::json;
+
+/**
+ * @brief A JsonCodec serializes and parses the documents handled by
+ * the json-typed functions of Collection, by DocumentBatch::parse and
+ * by the backends. Codecs are registered under their name; the
+ * "nlohmann" codec, based on nlohmann::json's dump and parse, is always
+ * available and is the default. When built with ENABLE_SIMDJSON, a
+ * "simdjson" codec parses documents with simdjson.
+ *
+ * Codecs must be usable concurrently from multiple threads.
+ */
+class JsonCodec {
+
+public:
+
+  virtual ~JsonCodec() = default;
+
+  /**
+   * @brief Name under which the codec is registered.
+   */
+  virtual std::string name() const = 0;
+
+  /**
+   * @brief Serializes the value into out, replacing its content.
+   */
+  virtual void dump(const json& value, std::string& out) const = 0;
+
+  /**
+   * @brief Parses a document. Throws an exception if the document
+   * is not valid JSON.
+   */
+  virtual json parse(std::string_view doc) const = 0;
+
+  /**
+   * @brief Parses a document, reporting its content to the handler
+   * as a sequence of SAX events instead of building a json value, so
+   * that the document can be read directly into user types.
+   *
+   * @return false if the document is not valid JSON or if the
+   * handler stopped the parsing by returning false.
+   */
+  virtual bool sax_parse(std::string_view doc, json::json_sax_t& handler) const = 0;
+
+  /**
+   * @brief Serializes the value.
+   */
+  std::string dump(const json& value) const {
+    std::string out;
+    dump(value, out);
+    return out;
+  }
+
+  /**
+   * @brief Registers a codec under its name, replacing any codec
+   * previously registered under that name. Registered codecs stay
+   * alive until the end of the program.
+   */
+  static void add(std::shared_ptr<JsonCodec> codec);
+
+  /**
+   * @brief Returns the codec registered under the name.
+   * Throws an Exception if there is none.
+   */
+  static std::shared_ptr<JsonCodec> get(const std::string& name);
+
+  /**
+   * @brief Names of the registered codecs.
+   */
+  static std::vector<std::string> names();
+
+  /**
+   * @brief Makes the codec registered under the name the one used by
+   * all collections. Throws an Exception if there is none.
+   */
+  static void set_default(const std::string& name);
+
+  /**
+   * @brief Codec used by all collections.
+   */
+  static const JsonCodec& current();
+
+  /**
+   * @brief Whether the codec used by all collections is the built-in
+   * "nlohmann" codec, in which case backends may use nlohmann::json
+   * directly. Compares the codec's identity, not its name, so it is
+   * cheap and a codec registered under that name is not mistaken for
+   * the built-in one.
+   */
+  static bool current_is_native();
+};
+
+} // namespace isonata
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_REQUEST_QUEUE_HPP
+#define __ISONATA_REQUEST_QUEUE_HPP
+
+#include <isonata/Collection.hpp>
+#include <isonata/AsyncResult.hpp>
+#include <isonata/Exception.hpp>
+#include <thallium.hpp>
+#include <exception>
+#include <memory>
+#include <string>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief A RequestQueue submits asynchronous operations to a Collection
+ * while keeping at most a fixed number of them (its depth) in flight.
+ * When the window is full, submitting either blocks the calling ULT
+ * until a request completes or throws an Exception, depending on the
+ * queue's policy. A RequestQueue may be shared by multiple ULTs.
+ *
+ * Each submission returns an AsyncResult that owns the operation's
+ * payload and result. Errors are reported by the AsyncResult and are
+ * also recorded by the queue so that flush() can report them.
+ */
+class RequestQueue {
+
+public:
+
+  enum class Policy {
+    Block, /* submitting to a full queue waits for a free slot */
+    Reject /* submitting to a full queue throws an Exception   */
+  };
+
+private:
+
+  struct State {
+    tl::mutex              mutex;
+    tl::condition_variable cv;
+    size_t                 in_flight = 0;
+    std::exception_ptr     error;
+  };
+
+  Collection             m_coll;
+  size_t                 m_depth;
+  Policy                 m_policy;
+  std::shared_ptr<State> m_state = std::make_shared<State>();
+
+  void acquire() {
+    std::unique_lock<tl::mutex> lock{m_state->mutex};
+    if(m_state->in_flight >= m_depth) {
+      if(m_policy == Policy::Reject)
+        throw Exception("RequestQueue is full");
+      m_state->cv.wait(lock, [this]() { return m_state->in_flight < m_depth; });
+    }
+    m_state->in_flight += 1;
+  }
+
+  static void release(const std::shared_ptr<State>& state,
+                      std::exception_ptr error) {
+    {
+      std::unique_lock<tl::mutex> lock{state->mutex};
+      state->in_flight -= 1;
+      if(error && !state->error) state->error = std::move(error);
+    }
+    state->cv.notify_all();
+  }
+
+public:
+
+  /**
+   * @brief Constructor.
+   *
+   * @param coll Collection to which operations are submitted.
+   * @param depth Maximum number of operations in flight.
+   * @param policy What to do when submitting to a full queue.
+   */
+  RequestQueue(Collection coll, size_t depth, Policy policy = Policy::Block)
+  : m_coll(std::move(coll))
+  , m_depth(depth ? depth : 1)
+  , m_policy(policy) {}
+
+  RequestQueue(const RequestQueue&) = delete;
+  RequestQueue& operator=(const RequestQueue&) = delete;
+
+  /**
+   * @brief The destructor waits for the operations in flight to
+   * complete. Errors not reported by flush() are discarded.
+   */
+  ~RequestQueue() {
+    drain();
+  }
+
+  /**
+   * @brief Submits an operation. The operation is a callable taking
+   * the Collection and returning an AsyncResult; it is invoked once
+   * a slot is available in the window.
+   *
+   * @param op Operation to submit.
+   *
+   * @return The AsyncResult returned by the operation.
+   */
+  template<typename Operation>
+  auto submit(Operation&& op) {
+    acquire();
+    decltype(op(m_coll)) result;
+    try {
+      result = op(m_coll);
+    } catch(...) {
+      release(m_state, nullptr);
+      throw;
+    }
+    auto state = m_state;
+    result.request().then([state](const AsyncRequest& req) {
+      std::exception_ptr error;
+      try { req.wait(); } catch(...) { error = std::current_exception(); }
+      release(state, std::move(error));
+    });
+    return result;
+  }
+
+  /**
+   * @brief Submits the storage of a document.
+   */
+  AsyncResult<uint64_t> store(std::string &&record, bool commit = false) {
+    return submit([&](const Collection& c) {
+      return c.store_async(std::move(record), commit);
+    });
+  }
+
+  /**
+   * @brief Submits the storage of a JSON document.
+   */
+  AsyncResult<uint64_t> store(json &&record, bool commit = false) {
+    return submit([&](const Collection& c) {
+      return c.store_async(std::move(record), commit);
+    });
+  }
+
+  /**
+   * @brief Submits the storage of multiple documents.
+   */
+  AsyncResult<std::vector<uint64_t>> store_multi(
+        std::vector<std::string> &&records, bool commit = false) {
+    return submit([&](const Collection& c) {
+      return c.store_multi_async(std::move(records), commit);
+    });
+  }
+
+  /**
+   * @brief Submits the retrieval of a document.
+   */
+  AsyncResult<std::string> fetch(uint64_t id) {
+    return submit([&](const Collection& c) {
+      return c.fetch_async(id);
+    });
+  }
+
+  /**
+   * @brief Submits the retrieval of a document as a JSON object.
+   */
+  AsyncResult<json> fetch_json(uint64_t id) {
+    return submit([&](const Collection& c) {
+      return c.fetch_json_async(id);
+    });
+  }
+
+  /**
+   * @brief Submits the update of a document.
+   */
+  AsyncResult<void> update(uint64_t id, std::string &&record, bool commit = false) {
+    return submit([&](const Collection& c) {
+      return c.update_async(id, std::move(record), commit);
+    });
+  }
+
+  /**
+   * @brief Submits the update of a document with a JSON object.
+   */
+  AsyncResult<void> update(uint64_t id, json &&record, bool commit = false) {
+    return submit([&](const Collection& c) {
+      return c.update_async(id, std::move(record), commit);
+    });
+  }
+
+  /**
+   * @brief Blocks until no operation is in flight.
+   */
+  void drain() {
+    std::unique_lock<tl::mutex> lock{m_state->mutex};
+    m_state->cv.wait(lock, [this]() { return m_state->in_flight == 0; });
+  }
+
+  /**
+   * @brief Blocks until no operation is in flight, then rethrows the
+   * first error encountered since the previous call to flush(), if any.
+   */
+  void flush() {
+    drain();
+    std::exception_ptr error;
+    {
+      std::unique_lock<tl::mutex> lock{m_state->mutex};
+      error.swap(m_state->error);
+    }
+    if(error) std::rethrow_exception(error);
+  }
+
+  /**
+   * @brief Number of operations currently in flight.
+   */
+  size_t in_flight() const {
+    std::unique_lock<tl::mutex> lock{m_state->mutex};
+    return m_state->in_flight;
+  }
+
+  /**
+   * @brief Maximum number of operations in flight.
+   */
+  size_t depth() const {
+    return m_depth;
+  }
+
+  /**
+   * @brief Collection to which operations are submitted.
+   */
+  const Collection& collection() const {
+    return m_coll;
+  }
+};
+
+} // namespace isonata
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_BATCHING_COLLECTION_HPP
+#define __ISONATA_BATCHING_COLLECTION_HPP
+
+#include <isonata/Collection.hpp>
+#include <isonata/Exception.hpp>
+#include "OperationAsyncRequest.hpp"
+#include <thallium.hpp>
+#include <ctime>
+#include <optional>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief Base class of the Collection decorators that gather individual
+ * operations into batches sent as a single RPC. Operations are added to
+ * the current batch with enqueue(). A batch is sent by the ULT whose
+ * operation fills it (max_count operations or max_bytes bytes), or by a
+ * linger ULT once linger_ms milliseconds have passed since its first
+ * operation. The Batch type must provide count() and bytes().
+ *
+ * Derived classes implement issue() and must call stop() in their
+ * destructor, which sends the remaining batch.
+ */
+template<typename Batch>
+class BatchingCollection : public Collection {
+
+  size_t                                         m_max_count;
+  size_t                                         m_max_bytes;
+  double                                         m_linger_ms;
+  mutable tl::mutex                              m_mutex;
+  mutable tl::condition_variable                 m_cv;
+  mutable std::shared_ptr<Batch>                 m_batch;
+  mutable uint64_t                               m_generation = 0;
+  mutable timespec                               m_deadline;
+  mutable bool                                   m_stop = false;
+  mutable std::optional<tl::managed<tl::thread>> m_linger;
+
+  static timespec deadlineAfter(double ms) {
+      timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      auto ns = ts.tv_nsec + static_cast<long>(ms*1e6);
+      ts.tv_sec  += ns / 1000000000L;
+      ts.tv_nsec  = ns % 1000000000L;
+      return ts;
+  }
+
+  static bool hasPassed(const timespec& deadline) {
+      timespec now;
+      clock_gettime(CLOCK_REALTIME, &now);
+      return now.tv_sec > deadline.tv_sec
+          || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec);
+  }
+
+  /**
+   * @brief Body of the linger ULT, which sends the current batch
+   * once its deadline has passed, and the remaining batch on stop().
+   */
+  void linger() const {
+      std::unique_lock<tl::mutex> lock{m_mutex};
+      while(true) {
+          while(!m_stop && !m_batch) m_cv.wait(lock);
+          if(!m_batch) return;
+          const auto generation = m_generation;
+          const auto deadline = m_deadline;
+          while(!m_stop && m_batch && m_generation == generation && !hasPassed(deadline))
+              m_cv.wait_until(lock, &deadline);
+          if(!m_batch || m_generation != generation) continue;
+          auto batch = std::move(m_batch);
+          lock.unlock();
+          issue(std::move(batch));
+          lock.lock();
+      }
+  }
+
+protected:
+
+  /**
+   * @brief Sends a batch. Called without holding the batching lock.
+   */
+  virtual void issue(std::shared_ptr<Batch> batch) const = 0;
+
+  /**
+   * @brief Calls add(batch) on the current batch, creating it if
+   * needed, and sends the batch if it is full. Returns what add returns.
+   */
+  template<typename Add>
+  auto enqueue(Add&& add) const {
+      std::shared_ptr<Batch> full;
+      decltype(add(std::declval<Batch&>())) result;
+      {
+          std::unique_lock<tl::mutex> lock{m_mutex};
+          if(!m_batch) {
+              m_batch = std::make_shared<Batch>();
+              m_generation += 1;
+              m_deadline = deadlineAfter(m_linger_ms);
+              if(!m_linger)
+                  m_linger = tl::xstream::self().get_main_pools(1)[0].make_thread(
+                      [this]() { linger(); });
+              m_cv.notify_one();
+          }
+          result = add(*m_batch);
+          if(m_batch->count() >= m_max_count || m_batch->bytes() >= m_max_bytes)
+              full = std::move(m_batch);
+      }
+      if(full) issue(std::move(full));
+      return result;
+  }
+
+  /**
+   * @brief Sends the remaining batch and stops the linger ULT.
+   */
+  void stop() const {
+      {
+          std::unique_lock<tl::mutex> lock{m_mutex};
+          m_stop = true;
+      }
+      m_cv.notify_all();
+      if(m_linger) (*m_linger)->join();
+      m_linger.reset();
+  }
+
+public:
+
+  BatchingCollection(Collection inner, size_t max_count,
+                     size_t max_bytes, double linger_ms)
+  : Collection(std::move(inner))
+  , m_max_count(max_count ? max_count : 1)
+  , m_max_bytes(max_bytes)
+  , m_linger_ms(linger_ms) {}
+};
+
+} // namespace isonata
+
+#endif
@@ -0,0 +1,343 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_CACHING_CLIENT_HPP
+#define __ISONATA_CACHING_CLIENT_HPP
+
+#include <isonata/Client.hpp>
+#include <isonata/Database.hpp>
+#include <isonata/Collection.hpp>
+#include <isonata/DocumentCache.hpp>
+#include "OperationAsyncRequest.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace isonata {
+
+/**
+ * @brief The CachingCollection wraps a Collection and serves the
+ * fetches of single records from a DocumentCache, filling the cache on
+ * misses. Updates, patches, increments and erases invalidate the
+ * records they modify both when issued and when completed, and the
+ * request returned to the caller completes only after the second
+ * invalidation. Documents read while an invalidation happens are not
+ * inserted (see DocumentCache::insert). Newly stored records have
+ * fresh ids and do not need invalidation.
+ */
+class CachingCollection : public Collection {
+
+  std::shared_ptr<DocumentCache> m_cache;
+  std::string                    m_scope;
+
+  /**
+   * @brief Calls issue(r) to start an operation on the underlying
+   * collection, then finish(r) once it has completed. If req is not
+   * null, it is set to a request that completes after finish has run
+   * and reports its exceptions.
+   */
+  template<typename Issue, typename Finish>
+  void chain(AsyncRequest* req, Issue&& issue, Finish&& finish) const {
+      if(!req) {
+          issue(nullptr);
+          finish(OperationAsyncRequest::completedRequest());
+          return;
+      }
+      AsyncRequest inner;
+      issue(&inner);
+      auto op = std::make_shared<OperationAsyncRequest>(
+          [inner, finish=std::forward<Finish>(finish)]() { finish(inner); });
+      inner.then([op](const AsyncRequest&) { op->run(); });
+      *req = AsyncRequest{std::move(op)};
+  }
+
+  template<typename Issue>
+  void invalidating(std::vector<uint64_t> ids, AsyncRequest* req, Issue&& issue) const {
+      for(auto id : ids) m_cache->erase(m_scope, id);
+      chain(req, std::forward<Issue>(issue),
+          [cache=m_cache, scope=m_scope, ids=std::move(ids)](const AsyncRequest& r) {
+              for(auto id : ids) cache->erase(scope, id);
+              r.wait();
+          });
+  }
+
+  template<typename SetResult>
+  void cachedFetch(uint64_t id, AsyncRequest* req, SetResult&& set_result) const {
+      auto doc = std::make_shared<std::string>();
+      if(m_cache->get(m_scope, id, doc.get())) {
+          set_result(*doc);
+          if(req) *req = OperationAsyncRequest::completedRequest();
+          return;
+      }
+      auto epoch = m_cache->epoch();
+      chain(req,
+          [&](AsyncRequest* r) { Collection::fetch(id, doc.get(), r); },
+          [cache=m_cache, scope=m_scope, id, epoch, doc,
+           set_result=std::forward<SetResult>(set_result)](const AsyncRequest& r) {
+              r.wait();
+              cache->insert(scope, id, *doc, epoch);
+              set_result(*doc);
+          });
+  }
+
+public:
+
+  CachingCollection(Collection inner, std::shared_ptr<DocumentCache> cache,
+                    std::string scope)
+  : Collection(std::move(inner))
+  , m_cache(std::move(cache))
+  , m_scope(std::move(scope)) {}
+
+  void fetch(uint64_t id, std::string *result,
+             AsyncRequest *req) const override {
+      cachedFetch(id, req, [result](std::string& doc) {
+          if(result) *result = std::move(doc);
+      });
+  }
+
+  void fetch(uint64_t id, json *result,
+             AsyncRequest *req) const override {
+      cachedFetch(id, req, [result](std::string& doc) {
+          if(result) *result = JsonCodec::current().parse(doc);
+      });
+  }
+
+  AsyncResult<std::string> fetch_async(uint64_t id) const override {
+      AsyncResult<std::string> result;
+      cachedFetch(id, result.request_ptr(), [result](std::string& doc) {
+          *result.value_ptr() = std::move(doc);
+      });
+      return result;
+  }
+
+  AsyncResult<json> fetch_json_async(uint64_t id) const override {
+      AsyncResult<json> result;
+      cachedFetch(id, result.request_ptr(), [result](std::string& doc) {
+          *result.value_ptr() = JsonCodec::current().parse(doc);
+      });
+      return result;
+  }
+
+  void update(uint64_t id, const json &record, bool commit,
+              AsyncRequest *req) const override {
+      invalidating({id}, req, [&](AsyncRequest* r) {
+          Collection::update(id, record, commit, r);
+      });
+  }
+
+  void update(uint64_t id, const std::string &record, bool commit,
+              AsyncRequest *req) const override {
+      invalidating({id}, req, [&](AsyncRequest* r) {
+          Collection::update(id, record, commit, r);
+      });
+  }
+
+  void update(uint64_t id, const char *record, bool commit,
+              AsyncRequest *req) const override {
+      invalidating({id}, req, [&](AsyncRequest* r) {
+          Collection::update(id, record, commit, r);
+      });
+  }
+
+  void update_multi(const uint64_t *ids, const json &records,
+                    std::vector<bool> *updated, bool commit,
+                    AsyncRequest *req) const override {
+      invalidating({ids, ids + records.size()}, req, [&](AsyncRequest* r) {
+          Collection::update_multi(ids, records, updated, commit, r);
+      });
+  }
+
+  void update_multi(const uint64_t *ids, const std::vector<std::string> &records,
+                    std::vector<bool> *updated, bool commit,
+                    AsyncRequest *req) const override {
+      invalidating({ids, ids + records.size()}, req, [&](AsyncRequest* r) {
+          Collection::update_multi(ids, records, updated, commit, r);
+      });
+  }
+
+  void update_multi(uint64_t *ids, const char *const *records, size_t count,
+                    std::vector<bool> *updated, bool commit,
+                    AsyncRequest *req) const override {
+      invalidating({ids, ids + count}, req, [&](AsyncRequest* r) {
+          Collection::update_multi(ids, records, count, updated, commit, r);
+      });
+  }
+
+  void update_multi(const uint64_t *ids, const char *data,
+                    const size_t *sizes, size_t count,
+                    std::vector<bool> *updated, bool commit,
+                    AsyncRequest *req) const override {
+      invalidating({ids, ids + count}, req, [&](AsyncRequest* r) {
+          Collection::update_multi(ids, data, sizes, count, updated, commit, r);
+      });
+  }
+
+  void update_multi(const uint64_t *ids, const std::string_view *records,
+                    size_t count, std::vector<bool> *updated, bool commit,
+                    AsyncRequest *req) const override {
+      invalidating({ids, ids + count}, req, [&](AsyncRequest* r) {
+          Collection::update_multi(ids, records, count, updated, commit, r);
+      });
+  }
+
+  // The base implementations keep the payload alive
+  // and go through the update overrides above.
+  AsyncResult<void> update_async(uint64_t id, std::string &&record,
+                                 bool commit) const override {
+      return AbstractCollectionImpl::update_async(id, std::move(record), commit);
+  }
+
+  AsyncResult<void> update_async(uint64_t id, json &&record,
+                                 bool commit) const override {
+      return AbstractCollectionImpl::update_async(id, std::move(record), commit);
+  }
+
+  void patch(uint64_t id, const json &patch, bool commit,
+             AsyncRequest *req) const override {
+      invalidating({id}, req, [&](AsyncRequest* r) {
+          Collection::patch(id, patch, commit, r);
+      });
+  }
+
+  void patch_multi(const uint64_t *ids, size_t count, const json &patch,
+                   bool commit, AsyncRequest *req) const override {
+      invalidating({ids, ids + count}, req, [&](AsyncRequest* r) {
+          Collection::patch_multi(ids, count, patch, commit, r);
+      });
+  }
+
+  void increment(uint64_t id, const std::string &field, const json &delta,
+                 json *result, bool commit, AsyncRequest *req) const override {
+      invalidating({id}, req, [&](AsyncRequest* r) {
+          Collection::increment(id, field, delta, result, commit, r);
+      });
+  }
+
+  void increment_multi(const uint64_t *ids, size_t count,
+                       const std::string &field, const json &delta,
+                       json *result, bool commit, AsyncRequest *req) const override {
+      invalidating({ids, ids + count}, req, [&](AsyncRequest* r) {
+          Collection::increment_multi(ids, count, field, delta, result, commit, r);
+      });
+  }
+
+  void erase(uint64_t id, bool commit, AsyncRequest *req) const override {
+      invalidating({id}, req, [&](AsyncRequest* r) {
+          Collection::erase(id, commit, r);
+      });
+  }
+
+  void erase_multi(const uint64_t *ids, size_t size, bool commit,
+                   AsyncRequest *req) const override {
+      invalidating({ids, ids + size}, req, [&](AsyncRequest* r) {
+          Collection::erase_multi(ids, size, commit, r);
+      });
+  }
+
+  void erase_range(uint64_t first, size_t count, bool commit,
+                   AsyncRequest *req) const override {
+      m_cache->erase_range(m_scope, first, count);
+      chain(req,
+          [&](AsyncRequest* r) { Collection::erase_range(first, count, commit, r); },
+          [cache=m_cache, scope=m_scope, first, count](const AsyncRequest& r) {
+              cache->erase_range(scope, first, count);
+              r.wait();
+          });
+  }
+};
+
+/**
+ * @brief The CachingDatabase wraps a Database so that the collections
+ * it opens or creates are CachingCollections. Dropping a collection
+ * invalidates its documents, and executing code invalidates all the
+ * documents of the database, since the code may modify any of them.
+ */
+class CachingDatabase : public Database {
+
+  std::shared_ptr<DocumentCache> m_cache;
+  std::string                    m_scope;
+
+  Collection wrap(Collection coll, const std::string &collectionName) const {
+      return Collection{std::make_shared<CachingCollection>(
+          std::move(coll), m_cache, m_scope + collectionName + "/")};
+  }
+
+public:
+
+  CachingDatabase(Database inner, std::shared_ptr<DocumentCache> cache,
+                  std::string scope)
+  : Database(std::move(inner))
+  , m_cache(std::move(cache))
+  , m_scope(std::move(scope)) {}
+
+  Collection create(const std::string &collectionName) const override {
+      return wrap(Database::create(collectionName), collectionName);
+  }
+
+  Collection create(const std::string &collectionName, const json &options) const override {
+      return wrap(Database::create(collectionName, options), collectionName);
+  }
+
+  Collection open(const std::string &collectionName, bool check) const override {
+      return wrap(Database::open(collectionName, check), collectionName);
+  }
+
+  void drop(const std::string &collectionName) const override {
+      Database::drop(collectionName);
+      m_cache->erase_prefix(m_scope + collectionName + "/");
+  }
+
+  void execute(const std::string &code,
+               const std::unordered_set<std::string> &vars,
+               std::unordered_map<std::string, std::string> *result,
+               bool commit) const override {
+      Database::execute(code, vars, result, commit);
+      m_cache->erase_prefix(m_scope);
+  }
+
+  void execute(const std::string &code,
+               const std::unordered_set<std::string> &vars, json *result,
+               bool commit) const override {
+      Database::execute(code, vars, result, commit);
+      m_cache->erase_prefix(m_scope);
+  }
+};
+
+/**
+ * @brief The CachingClient wraps a Client so that the databases it
+ * opens are CachingDatabases. Documents are cached under a scope made
+ * of the provider's address and id, the database and the collection.
+ */
+class CachingClient : public Client {
+
+  std::shared_ptr<DocumentCache> m_cache;
+
+public:
+
+  CachingClient(Client inner, std::shared_ptr<DocumentCache> cache)
+  : Client(std::move(inner))
+  , m_cache(std::move(cache)) {}
+
+  Database open(
+        const std::string &address, uint16_t provider_id,
+        const std::string &db_name, bool check) const override {
+      auto scope = address + "/" + std::to_string(provider_id) + "/" + db_name + "/";
+      return Database{std::make_shared<CachingDatabase>(
+          Client::open(address, provider_id, db_name, check), m_cache, std::move(scope))};
+  }
+
+  Database open(
+        const ProviderHandle &ph, const std::string &db_name,
+        bool check) const override {
+      auto scope = static_cast<std::string>(ph) + "/"
+                 + std::to_string(ph.provider_id()) + "/" + db_name + "/";
+      return Database{std::make_shared<CachingDatabase>(
+          Client::open(ph, db_name, check), m_cache, std::move(scope))};
+  }
+};
+
+} // namespace isonata
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_CHUNKED_OPERATION_HPP
+#define __ISONATA_CHUNKED_OPERATION_HPP
+
+#include <thallium.hpp>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <vector>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief Range [begin, end) of the items of a multi-operation,
+ * index being the position of the chunk in the operation.
+ */
+struct Chunk {
+    size_t index;
+    size_t begin;
+    size_t end;
+};
+
+/**
+ * @brief Splits count items into consecutive chunks of at most
+ * max_count items and at most max_bytes bytes, size(i) giving the size
+ * of the i-th item. An item larger than max_bytes forms its own chunk.
+ */
+template<typename Size>
+std::vector<Chunk> splitChunks(size_t count, size_t max_count,
+                               size_t max_bytes, Size&& size) {
+    std::vector<Chunk> chunks;
+    if(max_count == 0) max_count = 1;
+    size_t begin = 0;
+    size_t bytes = 0;
+    for(size_t i = 0; i < count; ++i) {
+        const size_t s = size(i);
+        if(i > begin && (i - begin == max_count || bytes + s > max_bytes)) {
+            chunks.push_back(Chunk{chunks.size(), begin, i});
+            begin = i;
+            bytes = 0;
+        }
+        bytes += s;
+    }
+    if(begin < count) chunks.push_back(Chunk{chunks.size(), begin, count});
+    return chunks;
+}
+
+/**
+ * @brief Calls f(chunk) for every chunk, running at most fanout calls
+ * concurrently: the calling ULT and up to fanout-1 ULTs created in the
+ * pool pick chunks in order until none are left. Once a call throws,
+ * no further chunk is started; the calls in progress are awaited,
+ * rollback(chunk) is called for every chunk whose call succeeded, and
+ * the first exception is rethrown.
+ */
+template<typename Function, typename Rollback>
+void runChunks(tl::pool pool, const std::vector<Chunk>& chunks,
+               size_t fanout, Function&& f, Rollback&& rollback) {
+    std::atomic<size_t> next{0};
+    std::atomic<bool>   failed{false};
+    std::vector<char>   completed(chunks.size(), 0);
+    std::exception_ptr  error;
+    tl::mutex           mutex;
+    auto work = [&]() {
+        for(size_t i = next++; i < chunks.size() && !failed; i = next++) {
+            try {
+                f(chunks[i]);
+                completed[i] = 1;
+            } catch(...) {
+                std::unique_lock<tl::mutex> lock{mutex};
+                if(!error) error = std::current_exception();
+                failed = true;
+            }
+        }
+    };
+    std::vector<tl::managed<tl::thread>> ults;
+    const auto num_ults = std::min(fanout, chunks.size());
+    if(num_ults > 1) {
+        for(size_t i = 1; i < num_ults; ++i)
+            ults.push_back(pool.make_thread(work));
+    }
+    work();
+    for(auto& ult : ults) ult->join();
+    if(!error) return;
+    for(size_t i = 0; i < chunks.size(); ++i) {
+        if(!completed[i]) continue;
+        try { rollback(chunks[i]); } catch(...) {}
+    }
+    std::rethrow_exception(error);
+}
+
+/**
+ * @brief Same as above, creating the ULTs in the caller's pool.
+ */
+template<typename Function, typename Rollback>
+void runChunks(const std::vector<Chunk>& chunks, size_t fanout,
+               Function&& f, Rollback&& rollback) {
+    if(chunks.size() > 1 && fanout > 1)
+        runChunks(tl::xstream::self().get_main_pools(1)[0], chunks, fanout,
+                  std::forward<Function>(f), std::forward<Rollback>(rollback));
+    else
+        runChunks(tl::pool{}, chunks, 1,
+                  std::forward<Function>(f), std::forward<Rollback>(rollback));
+}
+
+/**
+ * @brief Calls f(chunk) for every chunk as runChunks does, for
+ * operations that have nothing to roll back.
+ */
+template<typename Function>
+void runChunks(const std::vector<Chunk>& chunks, size_t fanout, Function&& f) {
+    runChunks(chunks, fanout, std::forward<Function>(f), [](const Chunk&) {});
+}
+
+} // namespace isonata
+
+#endif
@@ -1,5 +1,6 @@
 #include <isonata/Client.hpp>
 #include <Config.hpp>
+#include "CachingClient.hpp"
 #ifdef ENABLE_SONATA
 #include "sonata/SonataClient.hpp"
 #endif
@@ -9,22 +10,22 @@
 
 namespace isonata {
 
-Client Client::create(const thallium::engine& engine, const std::string& impl) {
+template<typename AsyncConfig>
+static std::shared_ptr<AbstractClientImpl> createClient(
+        const thallium::engine& engine, const std::string& impl,
+        const AsyncConfig& async_config) {
 
     if(impl == "sonata") {
 #ifdef ENABLE_SONATA
-        auto admin = Client{};
-        admin.self = std::make_shared<SonataClient>(engine);
-        return admin;
+        (void)async_config;
+        return std::make_shared<SonataClient>(engine);
 #else
         throw Exception("ISonata was not built with Sonata support");
 #endif
     }
     if(impl == "yokan") {
 #ifdef ENABLE_YOKAN
-        auto admin = Client{};
-        admin.self = std::make_shared<YokanClient>(engine);
-        return admin;
+        return std::make_shared<YokanClient>(engine, async_config);
 #else
         throw Exception("ISonata was not built with Yokan support");
 #endif
@@ -32,4 +33,30 @@ Client Client::create(const thallium::engine& engine, const std::string& impl) {
     throw Exception("Unknown implementation backend \"" + impl + "\"");
 }
 
+Client Client::create(const thallium::engine& engine, const std::string& impl) {
+    return create(engine, impl, nlohmann::json::object());
+}
+
+Client Client::create(const thallium::engine& engine, const std::string& impl,
+                      const nlohmann::json& config) {
+    auto admin = Client{};
+    admin.self = createClient(engine, impl, config);
+    return admin;
+}
+
+Client Client::create(const thallium::engine& engine, const std::string& impl,
+                      const thallium::pool& pool) {
+    auto admin = Client{};
+    admin.self = createClient(engine, impl, pool);
+    return admin;
+}
+
+Client Client::cached(std::shared_ptr<DocumentCache> cache) const {
+    if(!self) throw Exception("Invalid Client handle");
+    if(!cache) throw Exception("Invalid DocumentCache");
+    auto client = Client{};
+    client.self = std::make_shared<CachingClient>(*this, std::move(cache));
+    return client;
+}
+
 }
@@ -0,0 +1,167 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_COALESCING_COLLECTION_HPP
+#define __ISONATA_COALESCING_COLLECTION_HPP
+
+#include "BatchingCollection.hpp"
+#include <cstring>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief Batch of documents buffered by a CoalescingCollection.
+ */
+struct CoalescedStores {
+  std::string                                         data;
+  std::vector<size_t>                                 sizes;
+  std::vector<uint64_t>                               ids;
+  std::vector<std::shared_ptr<OperationAsyncRequest>> requests;
+  std::exception_ptr                                  error;
+  bool                                                commit = false;
+
+  size_t count() const { return sizes.size(); }
+  size_t bytes() const { return data.size(); }
+};
+
+/**
+ * @brief The CoalescingCollection wraps a Collection and turns the
+ * individual stores issued to it into store_multi RPCs of packed
+ * documents. Each store gets an OperationAsyncRequest that is run once
+ * the store_multi of its batch completes, setting the caller's record
+ * id or rethrowing the batch's error.
+ */
+class CoalescingCollection : public BatchingCollection<CoalescedStores> {
+
+  using Batch = CoalescedStores;
+
+  static void complete(Batch& batch) {
+      for(auto& req : batch.requests) req->run();
+  }
+
+  /**
+   * @brief Sends the batch as a single store_multi and completes the
+   * requests of its documents when it finishes.
+   */
+  void issue(std::shared_ptr<Batch> batch) const override {
+      batch->ids.resize(batch->sizes.size());
+      AsyncRequest req;
+      try {
+          Collection::store_multi(batch->data.data(), batch->sizes.data(),
+                                  batch->sizes.size(), batch->ids.data(),
+                                  batch->commit, &req);
+      } catch(...) {
+          batch->error = std::current_exception();
+          complete(*batch);
+          return;
+      }
+      // the continuation keeps the underlying collection alive
+      // in case this handle is destroyed before the batch completes
+      Collection inner = *this;
+      req.then([batch, inner](const AsyncRequest& r) {
+          try {
+              r.wait();
+          } catch(...) {
+              batch->error = std::current_exception();
+          }
+          complete(*batch);
+      });
+  }
+
+  /**
+   * @brief Appends a document to the current batch and returns the
+   * request that completes when the batch has been stored, after
+   * passing the document's record id to set_id.
+   */
+  template<typename SetId>
+  std::shared_ptr<OperationAsyncRequest> enqueue(
+        const char* data, size_t size, SetId&& set_id, bool commit) const {
+      return BatchingCollection::enqueue([&](Batch& b) {
+          auto batch = &b;
+          const auto index = batch->sizes.size();
+          batch->data.append(data, size);
+          batch->sizes.push_back(size);
+          batch->commit = batch->commit || commit;
+          // the batch owns the request, so the operation refers to it
+          // with a plain pointer to avoid a reference cycle
+          auto op = std::make_shared<OperationAsyncRequest>(
+              [batch, index, set_id=std::forward<SetId>(set_id)]() {
+                  if(batch->error) std::rethrow_exception(batch->error);
+                  set_id(batch->ids[index]);
+              });
+          batch->requests.push_back(op);
+          return op;
+      });
+  }
+
+public:
+
+  CoalescingCollection(Collection inner, const CoalescingOptions& options)
+  : BatchingCollection(std::move(inner), options.max_records,
+                       options.max_bytes, options.linger_ms) {}
+
+  ~CoalescingCollection() {
+      stop();
+  }
+
+  uint64_t store(const std::string &record, bool commit) const override {
+      uint64_t id;
+      store(record, &id, commit, nullptr);
+      return id;
+  }
+
+  uint64_t store(const json &record, bool commit) const override {
+      return store(JsonCodec::current().dump(record), commit);
+  }
+
+  uint64_t store(const char *record, bool commit) const override {
+      uint64_t id;
+      store(record, &id, commit, nullptr);
+      return id;
+  }
+
+  void store(const std::string &record, uint64_t *id, bool commit,
+             AsyncRequest *req) const override {
+      auto op = enqueue(record.data(), record.size(),
+                        [id](uint64_t i) { if(id) *id = i; }, commit);
+      if(req) *req = AsyncRequest{std::move(op)};
+      else op->wait();
+  }
+
+  void store(const json &record, uint64_t *id, bool commit,
+             AsyncRequest *req) const override {
+      store(JsonCodec::current().dump(record), id, commit, req);
+  }
+
+  void store(const char *record, uint64_t *id, bool commit,
+             AsyncRequest *req) const override {
+      auto op = enqueue(record, strlen(record),
+                        [id](uint64_t i) { if(id) *id = i; }, commit);
+      if(req) *req = AsyncRequest{std::move(op)};
+      else op->wait();
+  }
+
+  // The document is copied into the batch, so only the
+  // result needs to be kept alive by the operation.
+  AsyncResult<uint64_t> store_async(std::string &&record,
+                                    bool commit) const override {
+      AsyncResult<uint64_t> result;
+      auto op = enqueue(record.data(), record.size(),
+                        [result](uint64_t i) { *result.value_ptr() = i; }, commit);
+      *result.request_ptr() = AsyncRequest{std::move(op)};
+      return result;
+  }
+
+  AsyncResult<uint64_t> store_async(json &&record,
+                                    bool commit) const override {
+      return store_async(JsonCodec::current().dump(record), commit);
+  }
+};
+
+} // namespace isonata
+
+#endif
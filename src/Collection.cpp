@@ -0,0 +1,35 @@
+#include <isonata/Collection.hpp>
+#include <isonata/Cursor.hpp>
+#include "CoalescingCollection.hpp"
+#include "CombiningCollection.hpp"
+#include "MappedCollection.hpp"
+
+namespace isonata {
+
+Collection Collection::coalescing(const CoalescingOptions& options) const {
+    if(!self) throw Exception("Invalid Collection handle");
+    return Collection{std::make_shared<CoalescingCollection>(*this, options)};
+}
+
+Collection Collection::combining(const CombiningOptions& options) const {
+    if(!self) throw Exception("Invalid Collection handle");
+    return Collection{std::make_shared<CombiningCollection>(*this, options)};
+}
+
+Collection Collection::mapped(const std::string& path, bool validate) const {
+    if(!self) throw Exception("Invalid Collection handle");
+    try {
+        return Collection{std::make_shared<MappedCollection>(*this, path, validate)};
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+}
+
+Cursor Collection::cursor(uint64_t start_id, uint64_t end_id, size_t batch_size) const {
+    if(!self) throw Exception("Invalid Collection handle");
+    try {
+        if(end_id == std::numeric_limits<uint64_t>::max())
+            end_id = last_record_id() + 1;
+        return Cursor{*this, start_id, end_id, batch_size};
+    } catch(const std::exception& ex) { throw Exception(ex.what()); }
+}
+
+}
@@ -0,0 +1,156 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_COMBINING_COLLECTION_HPP
+#define __ISONATA_COMBINING_COLLECTION_HPP
+
+#include "BatchingCollection.hpp"
+#include <isonata/DocumentBatch.hpp>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief Batch of fetches gathered by a CombiningCollection.
+ * Fetches of the same record share a single entry in ids.
+ */
+struct CombinedFetches {
+  std::vector<uint64_t>                               ids;
+  std::unordered_map<uint64_t, size_t>                positions;
+  std::vector<std::shared_ptr<OperationAsyncRequest>> requests;
+  DocumentBatch                                       result;
+  std::exception_ptr                                  error;
+
+  size_t count() const { return ids.size(); }
+  size_t bytes() const { return 0; }
+};
+
+/**
+ * @brief The CombiningCollection wraps a Collection and turns the
+ * fetches of single records issued to it concurrently into fetch_multi
+ * RPCs. Each fetch gets an OperationAsyncRequest that is run once the
+ * fetch_multi of its batch completes, handing the caller its document
+ * or reporting that the record does not exist.
+ */
+class CombiningCollection : public BatchingCollection<CombinedFetches> {
+
+  using Batch = CombinedFetches;
+
+  static void complete(Batch& batch) {
+      batch.positions.clear();
+      for(size_t i = 0; i < batch.result.size(); ++i)
+          batch.positions.emplace(batch.result.id(i), i);
+      for(auto& req : batch.requests) req->run();
+  }
+
+  /**
+   * @brief Sends the batch as a single fetch_multi and completes the
+   * requests of its fetches when it finishes.
+   */
+  void issue(std::shared_ptr<Batch> batch) const override {
+      AsyncRequest req;
+      try {
+          Collection::fetch_multi(batch->ids.data(), batch->ids.size(),
+                                  &batch->result, &req);
+      } catch(...) {
+          batch->error = std::current_exception();
+          complete(*batch);
+          return;
+      }
+      // the continuation keeps the underlying collection alive
+      // in case this handle is destroyed before the batch completes
+      Collection inner = *this;
+      req.then([batch, inner](const AsyncRequest& r) {
+          try {
+              r.wait();
+          } catch(...) {
+              batch->error = std::current_exception();
+          }
+          complete(*batch);
+      });
+  }
+
+  /**
+   * @brief Adds a fetch to the current batch and returns the request
+   * that completes when the batch has been fetched, after passing the
+   * document to set_result.
+   */
+  template<typename SetResult>
+  std::shared_ptr<OperationAsyncRequest> enqueue(
+        uint64_t id, SetResult&& set_result) const {
+      return BatchingCollection::enqueue([&](Batch& b) {
+          auto batch = &b;
+          if(batch->positions.emplace(id, batch->ids.size()).second)
+              batch->ids.push_back(id);
+          // the batch owns the request, so the operation refers to it
+          // with a plain pointer to avoid a reference cycle
+          auto op = std::make_shared<OperationAsyncRequest>(
+              [batch, id, set_result=std::forward<SetResult>(set_result)]() {
+                  if(batch->error) std::rethrow_exception(batch->error);
+                  auto it = batch->positions.find(id);
+                  if(it == batch->positions.end())
+                      throw Exception{"Record " + std::to_string(id) + " does not exist"};
+                  set_result(batch->result, it->second);
+              });
+          batch->requests.push_back(op);
+          return op;
+      });
+  }
+
+  template<typename SetResult>
+  void fetch(uint64_t id, AsyncRequest *req, SetResult&& set_result) const {
+      auto op = enqueue(id, std::forward<SetResult>(set_result));
+      if(req) *req = AsyncRequest{std::move(op)};
+      else op->wait();
+  }
+
+public:
+
+  CombiningCollection(Collection inner, const CombiningOptions& options)
+  : BatchingCollection(std::move(inner), options.max_records,
+                       std::numeric_limits<size_t>::max(), options.linger_ms) {}
+
+  ~CombiningCollection() {
+      stop();
+  }
+
+  void fetch(uint64_t id, std::string *result,
+             AsyncRequest *req) const override {
+      fetch(id, req, [result](const DocumentBatch& batch, size_t i) {
+          if(result) result->assign(batch[i]);
+      });
+  }
+
+  void fetch(uint64_t id, json *result,
+             AsyncRequest *req) const override {
+      fetch(id, req, [result](const DocumentBatch& batch, size_t i) {
+          if(result) *result = batch.parse(i);
+      });
+  }
+
+  AsyncResult<std::string> fetch_async(uint64_t id) const override {
+      AsyncResult<std::string> result;
+      fetch(id, result.request_ptr(), [result](const DocumentBatch& batch, size_t i) {
+          result.value_ptr()->assign(batch[i]);
+      });
+      return result;
+  }
+
+  AsyncResult<json> fetch_json_async(uint64_t id) const override {
+      AsyncResult<json> result;
+      fetch(id, result.request_ptr(), [result](const DocumentBatch& batch, size_t i) {
+          *result.value_ptr() = batch.parse(i);
+      });
+      return result;
+  }
+};
+
+} // namespace isonata
+
+#endif
@@ -0,0 +1,44 @@
+#include "DocumentCompressor.hpp"
+#include <isonata/Exception.hpp>
+#include <Config.hpp>
+#ifdef ENABLE_ZSTD
+#include "ZstdCompressor.hpp"
+#endif
+
+namespace isonata {
+
+static std::string compressionMethod(const json& options) {
+    if(options.is_string()) return options.get<std::string>();
+    if(!options.is_object() || !options.contains("method") || !options["method"].is_string())
+        throw Exception{"\"compression\" field in collection options should be a "
+                        "method name or an object with a \"method\" field"};
+    return options["method"].get<std::string>();
+}
+
+std::shared_ptr<const DocumentCompressor> DocumentCompressor::create(
+        const json& options, std::string_view dictionary) {
+    auto method = compressionMethod(options);
+    if(method == "zstd") {
+#ifdef ENABLE_ZSTD
+        return std::make_shared<ZstdCompressor>(options, dictionary);
+#else
+        throw Exception("ISonata was not built with zstd support");
+#endif
+    }
+    throw Exception("Unknown compression method \"" + method + "\"");
+}
+
+std::string DocumentCompressor::train(const json& options,
+                                      const std::vector<std::string>& samples) {
+    auto method = compressionMethod(options);
+    if(method == "zstd") {
+#ifdef ENABLE_ZSTD
+        return ZstdCompressor::train(options, samples);
+#else
+        throw Exception("ISonata was not built with zstd support");
+#endif
+    }
+    throw Exception("Unknown compression method \"" + method + "\"");
+}
+
+}
@@ -0,0 +1,64 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_DOCUMENT_COMPRESSOR_HPP
+#define __ISONATA_DOCUMENT_COMPRESSOR_HPP
+
+#include <nlohmann/json.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace isonata {
+
+using nlohmann::json;
+
+/**
+ * @brief A DocumentCompressor compresses documents individually
+ * before a collection stores them, optionally with a dictionary
+ * trained on sample documents so that the keys and values they share
+ * compress well even in small documents. Compressors must be usable
+ * concurrently from multiple threads.
+ */
+class DocumentCompressor {
+
+public:
+
+  virtual ~DocumentCompressor() = default;
+
+  /**
+   * @brief Compresses the document into out, replacing its content.
+   */
+  virtual void compress(std::string_view doc, std::string& out) const = 0;
+
+  /**
+   * @brief Decompresses data into out, replacing its content.
+   * Throws an Exception if data is not valid.
+   */
+  virtual void decompress(std::string_view data, std::string& out) const = 0;
+
+  /**
+   * @brief Creates a compressor from the "compression" field of the
+   * options of Database::create, which is either the name of the
+   * method or an object with a "method" field and method-specific
+   * fields, and from a dictionary returned by train (empty for none).
+   * Throws an Exception if the options are invalid or if the method
+   * is not available.
+   */
+  static std::shared_ptr<const DocumentCompressor> create(
+        const json& options, std::string_view dictionary = {});
+
+  /**
+   * @brief Trains a dictionary for the method given in options from
+   * sample documents, as they will be stored before compression.
+   */
+  static std::string train(const json& options,
+                           const std::vector<std::string>& samples);
+};
+
+} // namespace isonata
+
+#endif
@@ -0,0 +1,109 @@
+#include <isonata/JsonCodec.hpp>
+#include <isonata/Exception.hpp>
+#include <Config.hpp>
+#ifdef ENABLE_SIMDJSON
+#include "SimdjsonCodec.hpp"
+#endif
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace isonata {
+
+namespace {
+
+/**
+ * @brief Codec relying on nlohmann::json's own dump and parse.
+ */
+class NlohmannCodec : public JsonCodec {
+
+public:
+
+    std::string name() const override {
+        return "nlohmann";
+    }
+
+    void dump(const json& value, std::string& out) const override {
+        out = value.dump();
+    }
+
+    json parse(std::string_view doc) const override {
+        return json::parse(doc.begin(), doc.end());
+    }
+
+    bool sax_parse(std::string_view doc, json::json_sax_t& handler) const override {
+        return json::sax_parse(doc.begin(), doc.end(), &handler);
+    }
+};
+
+/**
+ * @brief Registered codecs. Codecs replaced by add() are kept in
+ * retired, since current() may still return them.
+ */
+struct Registry {
+
+    std::mutex                                                  mutex;
+    std::unordered_map<std::string, std::shared_ptr<JsonCodec>> codecs;
+    std::vector<std::shared_ptr<JsonCodec>>                     retired;
+    std::atomic<const JsonCodec*>                               current;
+    const JsonCodec*                                            native;
+
+    Registry() {
+        auto nlohmann = std::make_shared<NlohmannCodec>();
+        current = nlohmann.get();
+        native  = nlohmann.get();
+        codecs["nlohmann"] = std::move(nlohmann);
+#ifdef ENABLE_SIMDJSON
+        codecs["simdjson"] = std::make_shared<SimdjsonCodec>();
+#endif
+    }
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+}
+
+void JsonCodec::add(std::shared_ptr<JsonCodec> codec) {
+    if(!codec) throw Exception("Invalid JsonCodec");
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock{r.mutex};
+    auto& entry = r.codecs[codec->name()];
+    if(entry) r.retired.push_back(std::move(entry));
+    entry = std::move(codec);
+}
+
+std::shared_ptr<JsonCodec> JsonCodec::get(const std::string& name) {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock{r.mutex};
+    auto it = r.codecs.find(name);
+    if(it == r.codecs.end())
+        throw Exception("Unknown JSON codec \"" + name + "\"");
+    return it->second;
+}
+
+std::vector<std::string> JsonCodec::names() {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock{r.mutex};
+    std::vector<std::string> result;
+    for(const auto& entry : r.codecs) result.push_back(entry.first);
+    return result;
+}
+
+void JsonCodec::set_default(const std::string& name) {
+    auto codec = get(name);
+    registry().current.store(codec.get(), std::memory_order_release);
+}
+
+const JsonCodec& JsonCodec::current() {
+    return *registry().current.load(std::memory_order_acquire);
+}
+
+bool JsonCodec::current_is_native() {
+    auto& r = registry();
+    return r.current.load(std::memory_order_acquire) == r.native;
+}
+
+}
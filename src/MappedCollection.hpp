@@ -0,0 +1,420 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_MAPPED_COLLECTION_HPP
+#define __ISONATA_MAPPED_COLLECTION_HPP
+
+#include <isonata/Collection.hpp>
+#include <isonata/DocumentBatch.hpp>
+#include <isonata/Exception.hpp>
+#include "OperationAsyncRequest.hpp"
+#include "Projection.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace isonata {
+
+/**
+ * @brief The MappedCollection is a read-only view of a collection
+ * whose documents are read from a local file mapped in memory. The
+ * file holds a header, an index of (record id, offset, size) entries
+ * sorted by record id, and the packed documents. If the file does not
+ * exist, or no longer matches the collection, it is rebuilt from a
+ * single all() on the collection, written to a temporary file and
+ * renamed, so concurrent processes never map a partially written file.
+ * Fetches and iterations are served from the mapping without RPCs;
+ * filters are forwarded to the collection; writes throw.
+ */
+class MappedCollection : public AbstractCollectionImpl {
+
+  struct Header {
+    char     magic[8];
+    uint64_t count;
+    uint64_t last_id;
+  };
+
+  struct Entry {
+    uint64_t id;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  static constexpr char s_magic[8] = {'I','S','O','N','M','A','P','1'};
+
+  Collection   m_coll;
+  void*        m_addr = MAP_FAILED;
+  size_t       m_length = 0;
+  const Header* m_header = nullptr;
+  const Entry*  m_index = nullptr;
+  const char*   m_data = nullptr;
+
+  bool map(const std::string& path) {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if(fd < 0) return false;
+      struct stat st;
+      if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+          ::close(fd);
+          return false;
+      }
+      m_length = st.st_size;
+      m_addr = mmap(nullptr, m_length, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if(m_addr == MAP_FAILED) return false;
+      m_header = static_cast<const Header*>(m_addr);
+      m_index  = reinterpret_cast<const Entry*>(m_header + 1);
+      bool valid = std::memcmp(m_header->magic, s_magic, sizeof(s_magic)) == 0
+                && m_header->count <= (m_length - sizeof(Header))/sizeof(Entry);
+      if(valid) m_data = reinterpret_cast<const char*>(m_index + m_header->count);
+      for(uint64_t i = 0; valid && i < m_header->count; ++i)
+          valid = m_data + m_index[i].offset + m_index[i].size
+               <= static_cast<const char*>(m_addr) + m_length;
+      if(!valid) unmap();
+      return valid;
+  }
+
+  void unmap() {
+      if(m_addr != MAP_FAILED) munmap(m_addr, m_length);
+      m_addr = MAP_FAILED;
+      m_header = nullptr;
+  }
+
+  static void build(const Collection& coll, const std::string& path) {
+      Header header;
+      std::memcpy(header.magic, s_magic, sizeof(s_magic));
+      header.last_id = coll.last_record_id();
+      DocumentBatch batch;
+      coll.all(&batch);
+      std::vector<Entry> index;
+      index.reserve(batch.size());
+      for(const auto& e : batch.entries()) index.push_back(Entry{e.id, e.offset, e.size});
+      std::sort(index.begin(), index.end(),
+                [](const Entry& a, const Entry& b) { return a.id < b.id; });
+      header.count = index.size();
+
+      // the file is written under a unique temporary name, then
+      // renamed, so that concurrent builds never share a file
+      std::string tmp = path + ".tmp.XXXXXX";
+      int fd = mkstemp(tmp.data());
+      if(fd < 0) throw Exception{"Could not create a temporary file for " + path};
+      auto file = fchmod(fd, 0644) == 0 ? fdopen(fd, "wb") : nullptr;
+      if(!file) {
+          close(fd);
+          std::remove(tmp.c_str());
+          throw Exception{"Could not create " + tmp};
+      }
+      bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+             && std::fwrite(index.data(), sizeof(Entry), index.size(), file) == index.size()
+             && std::fwrite(batch.data(), 1, batch.bytes(), file) == batch.bytes();
+      ok = (std::fclose(file) == 0) && ok;
+      if(!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+          std::remove(tmp.c_str());
+          throw Exception{"Could not write " + path};
+      }
+  }
+
+  const Entry* range(uint64_t first) const {
+      return std::lower_bound(m_index, m_index + m_header->count, first,
+          [](const Entry& e, uint64_t id) { return e.id < id; });
+  }
+
+  const Entry* find(uint64_t id) const {
+      auto it = range(id);
+      return (it != m_index + m_header->count && it->id == id) ? it : nullptr;
+  }
+
+  std::string_view doc(const Entry& e) const {
+      return std::string_view{m_data + e.offset, e.size};
+  }
+
+  std::string_view get(uint64_t id) const {
+      auto e = find(id);
+      if(!e) throw Exception{"Record " + std::to_string(id) + " does not exist"};
+      return doc(*e);
+  }
+
+  static void done(AsyncRequest* req) {
+      if(req) *req = OperationAsyncRequest::completedRequest();
+  }
+
+  [[noreturn]] static void readOnly() {
+      throw Exception{"Collection is read-only"};
+  }
+
+public:
+
+  MappedCollection(Collection coll, const std::string& path, bool validate)
+  : m_coll(std::move(coll)) {
+      bool mapped = map(path);
+      if(mapped && validate
+      && (m_header->count != m_coll.size()
+       || m_header->last_id != m_coll.last_record_id())) {
+          unmap();
+          mapped = false;
+      }
+      if(mapped) return;
+      build(m_coll, path);
+      if(!map(path)) throw Exception{"Could not map " + path};
+  }
+
+  MappedCollection(const MappedCollection&) = delete;
+  MappedCollection& operator=(const MappedCollection&) = delete;
+
+  ~MappedCollection() {
+      unmap();
+  }
+
+  operator bool() const override {
+      return m_header != nullptr;
+  }
+
+  void fetch(uint64_t id, std::string *result,
+             AsyncRequest *req) const override {
+      auto d = get(id);
+      if(result) result->assign(d);
+      done(req);
+  }
+
+  void fetch(uint64_t id, json *result,
+             AsyncRequest *req) const override {
+      auto d = get(id);
+      if(result) *result = JsonCodec::current().parse(d);
+      done(req);
+  }
+
+  void fetch_multi(const uint64_t *ids, size_t count,
+                   std::vector<std::string> *result,
+                   AsyncRequest *req) const override {
+      std::vector<std::string> docs;
+      docs.reserve(count);
+      for(size_t i = 0; i < count; ++i) docs.emplace_back(get(ids[i]));
+      if(result) *result = std::move(docs);
+      done(req);
+  }
+
+  void fetch_multi(const uint64_t *ids, size_t count, json *result,
+                   AsyncRequest *req) const override {
+      auto docs = json::array();
+      for(size_t i = 0; i < count; ++i) {
+          auto d = get(ids[i]);
+          docs.push_back(JsonCodec::current().parse(d));
+      }
+      if(result) *result = std::move(docs);
+      done(req);
+  }
+
+  void fetch_multi(const uint64_t *ids, size_t count, DocumentBatch *result,
+                   AsyncRequest *req) const override {
+      if(result) {
+          result->clear();
+          for(size_t i = 0; i < count; ++i) {
+              auto e = find(ids[i]);
+              if(e) result->push_back(e->id, m_data + e->offset, e->size);
+          }
+      }
+      done(req);
+  }
+
+  void filter(const std::string &filterCode, std::vector<std::string> *result,
+              AsyncRequest *req) const override {
+      m_coll.filter(filterCode, result, req);
+  }
+
+  void filter(const std::string &filterCode, json *result,
+              AsyncRequest *req) const override {
+      m_coll.filter(filterCode, result, req);
+  }
+
+  void filter(const std::string &filterCode, DocumentBatch *result,
+              AsyncRequest *req) const override {
+      m_coll.filter(filterCode, result, req);
+  }
+
+  void all(std::vector<std::string> *result, AsyncRequest *req) const override {
+      if(result) {
+          result->clear();
+          result->reserve(m_header->count);
+          for(uint64_t i = 0; i < m_header->count; ++i)
+              result->emplace_back(doc(m_index[i]));
+      }
+      done(req);
+  }
+
+  void all(json *result, AsyncRequest *req) const override {
+      if(result) {
+          *result = json::array();
+          for(uint64_t i = 0; i < m_header->count; ++i) {
+              auto d = doc(m_index[i]);
+              result->push_back(JsonCodec::current().parse(d));
+          }
+      }
+      done(req);
+  }
+
+  void all(DocumentBatch *result, AsyncRequest *req) const override {
+      if(result) {
+          result->clear();
+          for(uint64_t i = 0; i < m_header->count; ++i)
+              result->push_back(m_index[i].id, m_data + m_index[i].offset, m_index[i].size);
+      }
+      done(req);
+  }
+
+  void all(const std::function<void(const std::vector<std::string>&)> &callback,
+           size_t batch_size, AsyncRequest *req) const override {
+      if(batch_size == 0) batch_size = 1;
+      std::vector<std::string> docs;
+      for(uint64_t i = 0; i < m_header->count; i += batch_size) {
+          docs.clear();
+          for(uint64_t j = i; j < std::min<uint64_t>(i + batch_size, m_header->count); ++j)
+              docs.emplace_back(doc(m_index[j]));
+          callback(docs);
+      }
+      done(req);
+  }
+
+  void fetch_range(uint64_t first, size_t count, DocumentBatch *result,
+                   AsyncRequest *req) const override {
+      if(result) {
+          result->clear();
+          for(auto e = range(first); e != m_index + m_header->count
+                                  && e->id - first < count; ++e)
+              result->push_back(e->id, m_data + e->offset, e->size);
+      }
+      done(req);
+  }
+
+  void fetch_range(uint64_t first, size_t count, std::vector<std::string> *result,
+                   AsyncRequest *req) const override {
+      if(result) {
+          result->clear();
+          for(auto e = range(first); e != m_index + m_header->count
+                                  && e->id - first < count; ++e)
+              result->emplace_back(doc(*e));
+      }
+      done(req);
+  }
+
+  void fetch(uint64_t id, const std::vector<std::string> &fields,
+             json *result, AsyncRequest *req) const override {
+      Projection projection{fields};
+      auto d = get(id);
+      if(result) *result = projection.apply(JsonCodec::current().parse(d));
+      done(req);
+  }
+
+  void fetch_multi(const uint64_t *ids, size_t count,
+                   const std::vector<std::string> &fields,
+                   json *result, AsyncRequest *req) const override {
+      Projection projection{fields};
+      auto docs = json::array();
+      for(size_t i = 0; i < count; ++i) {
+          auto d = get(ids[i]);
+          docs.push_back(projection.apply(JsonCodec::current().parse(d)));
+      }
+      if(result) *result = std::move(docs);
+      done(req);
+  }
+
+  void filter(const std::string &filterCode, const std::vector<std::string> &fields,
+              json *result, AsyncRequest *req) const override {
+      m_coll.filter(filterCode, fields, result, req);
+  }
+
+  void erase_range(uint64_t, size_t, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void patch(uint64_t, const json&, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void patch_multi(const uint64_t*, size_t, const json&, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void increment(uint64_t, const std::string&, const json&, json*, bool,
+                 AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void increment_multi(const uint64_t*, size_t, const std::string&, const json&,
+                       json*, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  uint64_t last_record_id() const override {
+      return m_header->last_id;
+  }
+
+  size_t size() const override {
+      return m_header->count;
+  }
+
+  void store(const std::string&, uint64_t*, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void store_multi(const std::vector<std::string>&, uint64_t*,
+                   bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void store_multi(const char*, const size_t*, size_t,
+                   uint64_t*, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void store_multi(const std::string_view*, size_t,
+                   uint64_t*, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void update(uint64_t, const json&, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void update(uint64_t, const std::string&, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void update_multi(const uint64_t*, const json&, std::vector<bool>*,
+                    bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void update_multi(const uint64_t*, const std::vector<std::string>&,
+                    std::vector<bool>*, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void update_multi(const uint64_t*, const char*, const size_t*, size_t,
+                    std::vector<bool>*, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void update_multi(const uint64_t*, const std::string_view*, size_t,
+                    std::vector<bool>*, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void erase(uint64_t, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+
+  void erase_multi(const uint64_t*, size_t, bool, AsyncRequest*) const override {
+      readOnly();
+  }
+};
+
+} // namespace isonata
+
+#endif
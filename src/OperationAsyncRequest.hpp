@@ -0,0 +1,113 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_OPERATION_ASYNC_REQUEST_HPP
+#define __ISONATA_OPERATION_ASYNC_REQUEST_HPP
+
+#include <thallium.hpp>
+#include <isonata/AsyncRequest.hpp>
+#include <isonata/Exception.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief An OperationAsyncRequest holds an operation that is executed
+ * later by whichever ULT calls run() (a work queue's worker or a ULT
+ * dedicated to it). Any exception thrown by the operation is rethrown
+ * by wait(). Completion callbacks run in the ULT that ran the operation.
+ */
+class OperationAsyncRequest : public AbstractAsyncRequestImpl {
+
+  std::function<void()>                      m_operation;
+  std::exception_ptr                         m_error;
+  mutable tl::eventual<void>                 m_completed;
+  mutable tl::mutex                          m_mutex;
+  mutable bool                               m_done = false;
+  mutable uint64_t                           m_last_callback = 0;
+  mutable std::vector<std::pair<uint64_t, std::function<void()>>> m_callbacks;
+
+public:
+
+  template<typename Function>
+  OperationAsyncRequest(Function&& operation)
+  : m_operation(std::forward<Function>(operation))
+  {}
+
+  ~OperationAsyncRequest() {}
+
+  /**
+   * @brief Returns a request that has already completed, for
+   * operations that complete without issuing any RPC.
+   */
+  static AsyncRequest completedRequest() {
+      auto op = std::make_shared<OperationAsyncRequest>([]() {});
+      op->run();
+      return AsyncRequest{std::move(op)};
+  }
+
+  /**
+   * @brief Executes the operation and completes the request.
+   */
+  void run() {
+      try {
+          m_operation();
+      } catch(...) {
+          m_error = std::current_exception();
+      }
+      m_operation = nullptr;
+      std::vector<std::pair<uint64_t, std::function<void()>>> callbacks;
+      {
+          std::unique_lock<tl::mutex> lock{m_mutex};
+          m_done = true;
+          callbacks.swap(m_callbacks);
+      }
+      m_completed.set_value();
+      for(auto& cb : callbacks) cb.second();
+  }
+
+  void wait() const override {
+      m_completed.wait();
+      if(m_error) std::rethrow_exception(m_error);
+  }
+
+  bool completed() const override {
+      return m_completed.test();
+  }
+
+  uint64_t on_completion(std::function<void()> callback) const override {
+      {
+          std::unique_lock<tl::mutex> lock{m_mutex};
+          if(!m_done) {
+              m_callbacks.emplace_back(++m_last_callback, std::move(callback));
+              return m_last_callback;
+          }
+      }
+      callback();
+      return 0;
+  }
+
+  void remove_callback(uint64_t id) const override {
+      std::unique_lock<tl::mutex> lock{m_mutex};
+      m_callbacks.erase(std::remove_if(m_callbacks.begin(), m_callbacks.end(),
+                                       [id](const auto& cb) { return cb.first == id; }),
+                        m_callbacks.end());
+  }
+
+  operator bool() const override {
+      return true;
+  }
+};
+
+} // namespace isonata
+
+#endif
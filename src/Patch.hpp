@@ -0,0 +1,91 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_PATCH_HPP
+#define __ISONATA_PATCH_HPP
+
+#include <isonata/Exception.hpp>
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace isonata {
+
+using nlohmann::json;
+
+/**
+ * @brief Whether the patch is a JSON Patch (RFC 6902), i.e. an array
+ * of operations, rather than a JSON Merge Patch (RFC 7386).
+ */
+inline bool isJsonPatch(const json& patch) {
+    return patch.is_array();
+}
+
+/**
+ * @brief Applies the patch to the document: a JSON Patch if the patch
+ * is an array, a JSON Merge Patch otherwise.
+ */
+inline void applyPatch(json& doc, const json& patch) {
+    if(!isJsonPatch(patch)) {
+        doc.merge_patch(patch);
+        return;
+    }
+    try {
+        doc = doc.patch(patch);
+    } catch(const json::exception& ex) {
+        throw Exception{std::string{"Could not apply JSON Patch: "} + ex.what()};
+    }
+}
+
+/**
+ * @brief Sum of two integers, unsigned if the field was unsigned and
+ * the sum is not negative, signed if possible otherwise.
+ */
+template<typename T, typename U>
+json addIntegers(T value, U delta, const json::json_pointer& pointer) {
+    uint64_t u;
+    int64_t  s;
+    if(std::is_unsigned<T>::value && !__builtin_add_overflow(value, delta, &u)) return u;
+    if(!__builtin_add_overflow(value, delta, &s)) return s;
+    if(!__builtin_add_overflow(value, delta, &u)) return u;
+    throw Exception{"Incrementing field \"" + pointer.to_string() + "\" overflows"};
+}
+
+/**
+ * @brief Adds delta to the number at the pointer in the document and
+ * returns the new value. A missing field counts as 0. The sum of two
+ * integers is an integer, or an Exception is thrown if it does not fit
+ * in 64 bits; otherwise it is a floating-point number.
+ */
+inline json incrementField(json& doc, const json::json_pointer& pointer,
+                           const json& delta) {
+    if(!delta.is_number())
+        throw Exception{"Increment should be a number"};
+    json* value;
+    try {
+        value = &doc[pointer];
+    } catch(const json::exception&) {
+        throw Exception{"Field \"" + pointer.to_string() + "\" cannot be created"};
+    }
+    if(value->is_null()) *value = 0;
+    if(!value->is_number())
+        throw Exception{"Field \"" + pointer.to_string() + "\" is not a number"};
+    if(value->is_number_float() || delta.is_number_float())
+        *value = value->get<double>() + delta.get<double>();
+    else if(value->is_number_unsigned())
+        *value = delta.is_number_unsigned()
+               ? addIntegers(value->get<uint64_t>(), delta.get<uint64_t>(), pointer)
+               : addIntegers(value->get<uint64_t>(), delta.get<int64_t>(), pointer);
+    else
+        *value = delta.is_number_unsigned()
+               ? addIntegers(value->get<int64_t>(), delta.get<uint64_t>(), pointer)
+               : addIntegers(value->get<int64_t>(), delta.get<int64_t>(), pointer);
+    return *value;
+}
+
+} // namespace isonata
+
+#endif
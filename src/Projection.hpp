@@ -0,0 +1,109 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_PROJECTION_HPP
+#define __ISONATA_PROJECTION_HPP
+
+#include <isonata/Exception.hpp>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace isonata {
+
+using nlohmann::json;
+
+/**
+ * @brief A Projection reduces documents to a set of fields. Each field
+ * is a JSON pointer such as "/position/x"; a field that does not start
+ * with '/' names a top-level field. Projected documents keep each
+ * selected field at its path, and fields missing from the document
+ * are omitted.
+ */
+class Projection {
+
+  std::vector<json::json_pointer> m_pointers;
+  std::vector<std::vector<std::string>> m_tokens;
+
+public:
+
+  explicit Projection(const std::vector<std::string>& fields) {
+    m_pointers.reserve(fields.size());
+    m_tokens.reserve(fields.size());
+    for(const auto& field : fields) {
+      auto pointer = field.empty() || field[0] == '/' ? field : "/" + field;
+      try {
+        m_pointers.emplace_back(pointer);
+      } catch(const json::exception&) {
+        throw Exception{"Invalid field \"" + field + "\""};
+      }
+      auto& tokens = m_tokens.emplace_back();
+      for(size_t start = 1; start <= pointer.size();) {
+        auto end = std::min(pointer.find('/', start), pointer.size());
+        auto token = pointer.substr(start, end - start);
+        for(size_t i = 0; (i = token.find('~', i)) != std::string::npos; ++i)
+          token.replace(i, 2, token[i+1] == '1' ? "/" : "~");
+        tokens.push_back(std::move(token));
+        start = end + 1;
+      }
+    }
+  }
+
+  /**
+   * @brief Fields as JSON pointers.
+   */
+  json fields() const {
+    auto result = json::array();
+    for(const auto& pointer : m_pointers) result.push_back(pointer.to_string());
+    return result;
+  }
+
+  /**
+   * @brief Fields as arrays of keys, with the keys made only of
+   * digits as integers so that they can index arrays.
+   */
+  json paths() const {
+    auto result = json::array();
+    for(const auto& tokens : m_tokens) {
+      auto& path = result.emplace_back(json::array());
+      for(const auto& token : tokens) {
+        if(!token.empty() && token.size() < 19
+        && token.find_first_not_of("0123456789") == std::string::npos)
+          path.push_back(std::stoull(token));
+        else
+          path.push_back(token);
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @brief Returns the projection of the document.
+   */
+  json apply(const json& doc) const {
+    auto result = json::object();
+    for(const auto& pointer : m_pointers) {
+      if(doc.contains(pointer)) result[pointer] = doc[pointer];
+    }
+    return result;
+  }
+
+  /**
+   * @brief Builds a projected document from the values of its fields,
+   * in the order of the fields, each value being wrapped in a
+   * one-element array, or an empty array if the field is missing.
+   */
+  json fromValues(const json& values) const {
+    auto result = json::object();
+    for(size_t i = 0; i < m_pointers.size() && i < values.size(); ++i) {
+      if(!values[i].empty()) result[m_pointers[i]] = values[i][0];
+    }
+    return result;
+  }
+};
+
+} // namespace isonata
+
+#endif
@@ -26,8 +26,7 @@ Provider Provider::create(thallium::engine& engine, const std::string& impl,
         auto provider = Provider{};
         std::string cfg = config.empty() ? "{}" : config;
         provider.self = std::make_shared<YokanProvider>(
-            engine.get_margo_instance(), provider_id, "",
-            cfg.c_str(), pool.native_handle());
+            engine, provider_id, cfg, pool);
         return provider;
 #else
         throw Exception("ISonata was not built with Yokan support");
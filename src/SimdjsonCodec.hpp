@@ -0,0 +1,133 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_SIMDJSON_CODEC_HPP
+#define __ISONATA_SIMDJSON_CODEC_HPP
+
+#include <isonata/JsonCodec.hpp>
+#include <isonata/Exception.hpp>
+#include <simdjson.h>
+
+namespace isonata {
+
+/**
+ * @brief The SimdjsonCodec parses documents with simdjson's DOM
+ * parser, which validates and indexes a document with SIMD
+ * instructions, then converts the resulting tree into a json value
+ * or walks it to emit SAX events. Each thread uses its own parser so
+ * that its buffers are reused across documents. simdjson does not
+ * serialize arbitrary values, so dump uses nlohmann::json.
+ */
+class SimdjsonCodec : public JsonCodec {
+
+  static simdjson::dom::element load(std::string_view doc) {
+      thread_local simdjson::dom::parser parser;
+      simdjson::dom::element root;
+      auto error = parser.parse(doc.data(), doc.size()).get(root);
+      if(error) throw Exception{std::string{"Invalid JSON document: "}
+                                + simdjson::error_message(error)};
+      return root;
+  }
+
+  static json convert(simdjson::dom::element e) {
+      using simdjson::dom::element_type;
+      switch(e.type()) {
+      case element_type::ARRAY: {
+          simdjson::dom::array children = e.get_array().value_unsafe();
+          json array = json::array();
+          auto& values = array.get_ref<json::array_t&>();
+          for(auto child : children) values.push_back(convert(child));
+          return array;
+      }
+      case element_type::OBJECT: {
+          simdjson::dom::object children = e.get_object().value_unsafe();
+          json object = json::object();
+          auto& fields = object.get_ref<json::object_t&>();
+          for(auto field : children)
+              fields[std::string{field.key}] = convert(field.value);
+          return object;
+      }
+      case element_type::INT64:
+          return json(e.get_int64().value_unsafe());
+      case element_type::UINT64:
+          return json(e.get_uint64().value_unsafe());
+      case element_type::DOUBLE:
+          return json(e.get_double().value_unsafe());
+      case element_type::STRING:
+          return json(e.get_string().value_unsafe());
+      case element_type::BOOL:
+          return json(e.get_bool().value_unsafe());
+      case element_type::NULL_VALUE:
+      default:
+          return json(nullptr);
+      }
+  }
+
+  static bool emit(simdjson::dom::element e, json::json_sax_t& sax) {
+      using simdjson::dom::element_type;
+      switch(e.type()) {
+      case element_type::ARRAY: {
+          simdjson::dom::array array = e.get_array().value_unsafe();
+          if(!sax.start_array(array.size())) return false;
+          for(auto child : array)
+              if(!emit(child, sax)) return false;
+          return sax.end_array();
+      }
+      case element_type::OBJECT: {
+          simdjson::dom::object object = e.get_object().value_unsafe();
+          if(!sax.start_object(object.size())) return false;
+          std::string key;
+          for(auto field : object) {
+              key.assign(field.key);
+              if(!sax.key(key) || !emit(field.value, sax)) return false;
+          }
+          return sax.end_object();
+      }
+      case element_type::INT64:
+          return sax.number_integer(e.get_int64().value_unsafe());
+      case element_type::UINT64:
+          return sax.number_unsigned(e.get_uint64().value_unsafe());
+      case element_type::DOUBLE:
+          return sax.number_float(e.get_double().value_unsafe(), std::string{});
+      case element_type::STRING: {
+          std::string value{e.get_string().value_unsafe()};
+          return sax.string(value);
+      }
+      case element_type::BOOL:
+          return sax.boolean(e.get_bool().value_unsafe());
+      case element_type::NULL_VALUE:
+      default:
+          return sax.null();
+      }
+  }
+
+public:
+
+  std::string name() const override {
+      return "simdjson";
+  }
+
+  void dump(const json& value, std::string& out) const override {
+      out = value.dump();
+  }
+
+  json parse(std::string_view doc) const override {
+      return convert(load(doc));
+  }
+
+  bool sax_parse(std::string_view doc, json::json_sax_t& handler) const override {
+      simdjson::dom::element root;
+      try {
+          root = load(doc);
+      } catch(const Exception&) {
+          return false;
+      }
+      return emit(root, handler);
+  }
+};
+
+} // namespace isonata
+
+#endif
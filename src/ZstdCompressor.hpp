@@ -0,0 +1,119 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_ZSTD_COMPRESSOR_HPP
+#define __ISONATA_ZSTD_COMPRESSOR_HPP
+
+#include "DocumentCompressor.hpp"
+#include <isonata/Exception.hpp>
+#include <zstd.h>
+#include <zdict.h>
+
+namespace isonata {
+
+/**
+ * @brief The ZstdCompressor compresses each document as a zstd frame,
+ * with a digested dictionary if one was trained. Each thread uses its
+ * own compression and decompression contexts, so that they are reused
+ * across documents.
+ */
+class ZstdCompressor : public DocumentCompressor {
+
+  std::shared_ptr<ZSTD_CDict> m_cdict;
+  std::shared_ptr<ZSTD_DDict> m_ddict;
+  int                         m_level;
+
+  static constexpr int    s_default_level = 3;
+  static constexpr size_t s_default_dictionary_size = 16*1024;
+
+  static size_t check(size_t code) {
+      if(ZSTD_isError(code))
+          throw Exception{std::string{"zstd error: "} + ZSTD_getErrorName(code)};
+      return code;
+  }
+
+  static ZSTD_CCtx* cctx() {
+      thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> ctx{
+          ZSTD_createCCtx(), ZSTD_freeCCtx};
+      return ctx.get();
+  }
+
+  static ZSTD_DCtx* dctx() {
+      thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> ctx{
+          ZSTD_createDCtx(), ZSTD_freeDCtx};
+      return ctx.get();
+  }
+
+  static size_t getSize(const json& options, const char* field, size_t default_value) {
+      if(!options.is_object() || !options.contains(field)) return default_value;
+      const auto& value = options[field];
+      if(!value.is_number_unsigned())
+          throw Exception{std::string{"\"compression."} + field + "\" should be an unsigned integer"};
+      return value.get<size_t>();
+  }
+
+public:
+
+  ZstdCompressor(const json& options, std::string_view dictionary)
+  : m_level(s_default_level) {
+      if(options.is_object() && options.contains("level")) {
+          if(!options["level"].is_number_integer())
+              throw Exception{"\"compression.level\" should be an integer"};
+          m_level = options["level"].get<int>();
+      }
+      if(dictionary.empty()) return;
+      m_cdict.reset(ZSTD_createCDict(dictionary.data(), dictionary.size(), m_level),
+                    ZSTD_freeCDict);
+      m_ddict.reset(ZSTD_createDDict(dictionary.data(), dictionary.size()),
+                    ZSTD_freeDDict);
+      if(!m_cdict || !m_ddict)
+          throw Exception{"Invalid zstd dictionary"};
+  }
+
+  void compress(std::string_view doc, std::string& out) const override {
+      out.resize(ZSTD_compressBound(doc.size()));
+      auto size = m_cdict
+          ? ZSTD_compress_usingCDict(cctx(), out.data(), out.size(),
+                                     doc.data(), doc.size(), m_cdict.get())
+          : ZSTD_compressCCtx(cctx(), out.data(), out.size(),
+                              doc.data(), doc.size(), m_level);
+      out.resize(check(size));
+  }
+
+  void decompress(std::string_view data, std::string& out) const override {
+      auto bound = ZSTD_getFrameContentSize(data.data(), data.size());
+      if(bound == ZSTD_CONTENTSIZE_ERROR || bound == ZSTD_CONTENTSIZE_UNKNOWN)
+          throw Exception{"Invalid zstd frame"};
+      out.resize(bound);
+      auto size = m_ddict
+          ? ZSTD_decompress_usingDDict(dctx(), out.data(), out.size(),
+                                       data.data(), data.size(), m_ddict.get())
+          : ZSTD_decompressDCtx(dctx(), out.data(), out.size(),
+                                data.data(), data.size());
+      out.resize(check(size));
+  }
+
+  static std::string train(const json& options, const std::vector<std::string>& samples) {
+      std::string buffer;
+      std::vector<size_t> sizes;
+      sizes.reserve(samples.size());
+      for(const auto& sample : samples) {
+          buffer += sample;
+          sizes.push_back(sample.size());
+      }
+      std::string dictionary(getSize(options, "dictionary_size", s_default_dictionary_size), '\0');
+      auto size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(),
+                                        buffer.data(), sizes.data(), sizes.size());
+      if(ZDICT_isError(size))
+          throw Exception{std::string{"Could not train zstd dictionary: "}
+                          + ZDICT_getErrorName(size)};
+      dictionary.resize(size);
+      return dictionary;
+  }
+};
+
+} // namespace isonata
+
+#endif
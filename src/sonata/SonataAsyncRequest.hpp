@@ -5,17 +5,56 @@
  */
 #include <isonata/AsyncRequest.hpp>
 #include <sonata/AsyncRequest.hpp>
+#include <thallium.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <exception>
+#include <utility>
+#include <vector>
 
 namespace isonata {
 
+namespace tl = thallium;
+
 class SonataCollection;
 
-class SonataAsyncRequest : public AbstractAsyncRequestImpl {
+class SonataAsyncRequest : public AbstractAsyncRequestImpl,
+                           public std::enable_shared_from_this<SonataAsyncRequest> {
 
   friend class SonataCollection;
 
   sonata::AsyncRequest req;
 
+  // A sonata::AsyncRequest can only be waited on once, so the first
+  // ULT to wait marks the request as waited on, waits without holding
+  // the mutex, and records the outcome; other ULTs wait on the
+  // eventual.
+  mutable tl::mutex                          mutex;
+  mutable tl::eventual<void>                 outcome;
+  mutable std::atomic<bool>                  done{false};
+  mutable bool                               waiting = false;
+  mutable std::exception_ptr                 error;
+  mutable uint64_t                           last_callback = 0;
+  mutable std::vector<std::pair<uint64_t, std::function<void()>>> callbacks;
+
+  void complete() const {
+    try {
+      req.wait();
+    } catch(...) {
+      error = std::current_exception();
+    }
+    std::vector<std::pair<uint64_t, std::function<void()>>> to_call;
+    {
+      std::unique_lock<tl::mutex> lock{mutex};
+      done = true;
+      to_call.swap(callbacks);
+    }
+    outcome.set_value();
+    for(auto& cb : to_call) cb.second();
+  }
+
 public:
 
   SonataAsyncRequest(sonata::AsyncRequest r = sonata::AsyncRequest{})
@@ -24,11 +63,49 @@ public:
   ~SonataAsyncRequest() {}
 
   void wait() const override {
-    req.wait();
+    bool first;
+    {
+      std::unique_lock<tl::mutex> lock{mutex};
+      first = !waiting;
+      waiting = true;
+    }
+    if(first) complete();
+    else outcome.wait();
+    if(error) std::rethrow_exception(error);
   }
 
   bool completed() const override {
-    return req.completed();
+    if(done) return true;
+    // the request cannot be tested while a ULT is waiting on it
+    std::unique_lock<tl::mutex> lock{mutex};
+    return !waiting && req.completed();
+  }
+
+  uint64_t on_completion(std::function<void()> callback) const override {
+    // Sonata does not provide completion notifications, so unless a
+    // ULT is already waiting on the request, a ULT is started to wait.
+    {
+      std::unique_lock<tl::mutex> lock{mutex};
+      if(!done) {
+        callbacks.emplace_back(++last_callback, std::move(callback));
+        if(!waiting) {
+          waiting = true;
+          auto self = shared_from_this();
+          tl::xstream::self().get_main_pools(1)[0].make_thread(
+            [self]() { self->complete(); }, tl::anonymous{});
+        }
+        return last_callback;
+      }
+    }
+    callback();
+    return 0;
+  }
+
+  void remove_callback(uint64_t id) const override {
+    std::unique_lock<tl::mutex> lock{mutex};
+    callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(),
+                                   [id](const auto& cb) { return cb.first == id; }),
+                    callbacks.end());
   }
 
   operator bool() const override {
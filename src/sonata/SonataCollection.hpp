@@ -4,8 +4,18 @@
  * See COPYRIGHT in top-level directory.
  */
 #include <isonata/Collection.hpp>
+#include <isonata/JsonCodec.hpp>
 #include <sonata/Collection.hpp>
+#include <sonata/Database.hpp>
 #include "SonataAsyncRequest.hpp"
+#include "../OperationAsyncRequest.hpp"
+#include "../ChunkedOperation.hpp"
+#include "../Patch.hpp"
+#include "../Projection.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string_view>
 
 namespace isonata {
 
@@ -15,11 +25,447 @@ using nlohmann::json;
 class SonataCollection : public AbstractCollectionImpl {
 
   sonata::Collection coll;
+  sonata::Database   db;
+  std::string        name;
+
+  /**
+   * @brief Runs the function in a separate ULT if req is not null
+   * (setting req to track it), or in the calling ULT otherwise.
+   */
+  template<typename Function>
+  static void run(Function&& f, AsyncRequest *req) {
+    if(req) {
+      auto op = std::make_shared<OperationAsyncRequest>(std::forward<Function>(f));
+      tl::xstream::self().get_main_pools(1)[0].make_thread(
+        [op]() { op->run(); }, tl::anonymous{});
+      *req = AsyncRequest{std::move(op)};
+    } else {
+      f();
+    }
+  }
+
+  /**
+   * @brief Appends the documents to the batch, using the __id field
+   * that UnQLite adds to every record as record id.
+   */
+  static void toBatch(const std::vector<std::string>& docs, DocumentBatch* batch) {
+    for(const auto& doc : docs) {
+      if(doc.empty() || doc == "null") continue;
+      auto id = JsonCodec::current().parse(doc).value("__id", uint64_t{0});
+      batch->push_back(id, doc.data(), doc.size());
+    }
+  }
+
+  /**
+   * @brief Whether json values can be handed to Sonata, which
+   * serializes and parses them with nlohmann::json. Otherwise they
+   * go through the current JsonCodec and Sonata's string functions.
+   */
+  static bool nativeJson() {
+    return JsonCodec::current_is_native();
+  }
+
+  /**
+   * @brief Parses the documents with the current JsonCodec into
+   * a json array, empty documents becoming null.
+   */
+  static void parseAll(const std::vector<std::string>& docs, json* result) {
+    if(!result) return;
+    const auto& codec = JsonCodec::current();
+    json::array_t values;
+    values.reserve(docs.size());
+    for(const auto& doc : docs)
+      values.push_back(doc.empty() ? json() : codec.parse(doc));
+    *result = std::move(values);
+  }
+
+  /**
+   * @brief Sonata only accepts null-terminated records, so this
+   * function copies the records once into a single buffer with a
+   * terminating character after each of them, and fills ptrs with
+   * pointers to each record in that buffer. Sonata serializes the
+   * records before returning, so the buffer only needs to live for
+   * the duration of the call.
+   */
+  static std::vector<char> nullTerminated(
+        const std::string_view *records, size_t count,
+        std::vector<const char*>& ptrs) {
+    size_t total = 0;
+    for(size_t i = 0; i < count; ++i) total += records[i].size() + 1;
+    std::vector<char> buffer(total);
+    ptrs.resize(count);
+    size_t offset = 0;
+    for(size_t i = 0; i < count; ++i) {
+      std::memcpy(buffer.data() + offset, records[i].data(), records[i].size());
+      ptrs[i] = buffer.data() + offset;
+      offset += records[i].size();
+      buffer[offset++] = '\0';
+    }
+    return buffer;
+  }
+
+  static constexpr size_t s_chunk_count = 4096;
+  static constexpr size_t s_chunk_bytes = 4*1024*1024;
+  static constexpr size_t s_chunk_fanout = 4;
+
+  static constexpr size_t s_swap_attempts = 16;
+
+  /**
+   * @brief Stores the records chunk by chunk, each chunk being a single
+   * store_multi, with up to s_chunk_fanout chunks in flight. If a chunk
+   * fails, the chunks already stored are erased before the error is
+   * reported, so the records are still stored entirely or not at all,
+   * but other clients may read the records of a chunk before they are
+   * erased, and the ids of different chunks are not ordered.
+   */
+  void storeChunks(const std::vector<Chunk>& chunks, const char *const *records,
+                   uint64_t *ids, bool commit) const {
+    std::vector<uint64_t> local;
+    if(!ids) {
+      local.resize(chunks.empty() ? 0 : chunks.back().end);
+      ids = local.data();
+    }
+    runChunks(chunks, s_chunk_fanout,
+      [&](const Chunk& c) {
+        coll.store_multi(records + c.begin, c.end - c.begin, ids + c.begin, commit);
+      },
+      [&](const Chunk& c) {
+        coll.erase_multi(ids + c.begin, c.end - c.begin, commit);
+      });
+  }
+
+  void storeChunks(const std::vector<Chunk>& chunks, const std::string_view *records,
+                   size_t count, uint64_t *ids, bool commit) const {
+    std::vector<const char*> ptrs;
+    auto buffer = nullTerminated(records, count, ptrs);
+    storeChunks(chunks, ptrs.data(), ids, commit);
+  }
+
+  /**
+   * @brief Fetches the records with fetch_multi, in chunks of at most
+   * s_chunk_count ids with up to s_chunk_fanout chunks in flight, and
+   * concatenates the results in order. Document sizes are not known
+   * before fetching them, so chunks are sized by number of ids only.
+   */
+  template<typename Results>
+  void fetchChunks(const uint64_t *ids, size_t count, Results *result) const {
+    auto chunks = splitChunks(count, s_chunk_count, std::numeric_limits<size_t>::max(),
+                              [](size_t) { return size_t{0}; });
+    std::vector<Results> parts(chunks.size());
+    runChunks(chunks, s_chunk_fanout, [&](const Chunk& c) {
+      coll.fetch_multi(ids + c.begin, c.end - c.begin, &parts[c.index]);
+    });
+    if(!result) return;
+    *result = std::move(parts[0]);
+    for(size_t i = 1; i < parts.size(); ++i)
+      for(auto& doc : parts[i]) result->push_back(std::move(doc));
+  }
+
+  /**
+   * @brief Jx9 literal for the value: its JSON text, with '$' escaped
+   * since Jx9 expands variables in double-quoted strings.
+   */
+  static std::string jx9Literal(const json& value) {
+    std::string code;
+    for(char c : value.dump()) {
+      if(c == '$') code += '\\';
+      code += c;
+    }
+    return code;
+  }
+
+  /**
+   * @brief Jx9 code that sets $values to the values of the fields of
+   * $doc, in the format expected by Projection::fromValues.
+   */
+  static std::string jx9Project(const Projection& projection) {
+    return
+      "$values = [];"
+      "foreach(" + jx9Literal(projection.paths()) + " as $path) {"
+      "  $v = $doc; $found = TRUE;"
+      "  foreach($path as $key) {"
+      "    if(is_array($v) && array_key_exists($key, $v)) { $v = $v[$key]; }"
+      "    else { $found = FALSE; break; }"
+      "  }"
+      "  if($found) { array_push($values, [$v]); } else { array_push($values, []); }"
+      "}";
+  }
+
+  /**
+   * @brief Runs the script and returns the values of the variables
+   * as a JSON object.
+   */
+  json runScript(const std::string& script,
+                 const std::unordered_set<std::string>& vars, bool commit) const {
+    json values;
+    db.execute(script, vars, &values, commit);
+    for(auto& [var, value] : values.items()) {
+      if(value.is_string()) value = json::parse(value.get<std::string>());
+    }
+    return values;
+  }
+
+  /**
+   * @brief Runs the script, which should set $result to an array of
+   * projected documents (each an array of values, or NULL if the
+   * record does not exist), and returns that array.
+   */
+  json runProjection(const std::string& script) const {
+    return runScript(script, {"result"}, false)["result"];
+  }
+
+  /**
+   * @brief Jx9 code running body with $id set to each id in
+   * [first, first+count) up to the last record id of the collection,
+   * which the provider looks up, so that range operations do not ship
+   * ids. Jx9 integers are signed, hence the bound on the end.
+   */
+  std::string jx9ForRange(uint64_t first, size_t count, const std::string& body) const {
+    const uint64_t max = std::numeric_limits<int64_t>::max();
+    const uint64_t end = first >= max || count > max - first ? max : first + count;
+    return
+      "$end = db_last_record_id(" + jx9Literal(name) + ") + 1;"
+      "if($end > " + std::to_string(end) + ") { $end = " + std::to_string(end) + "; }"
+      "for($id = " + std::to_string(std::min(first, max)) + "; $id < $end; $id++) {"
+      + body +
+      "}";
+  }
+
+  /**
+   * @brief Appends to code the Jx9 statements that apply the merge
+   * patch to the document in the target variable. Arrays and objects
+   * are both arrays in Jx9, so the structure of the patch, which is
+   * known here, drives the generated code.
+   */
+  static void jx9MergePatch(const json& patch, const std::string& target,
+                            std::string& code) {
+    if(!patch.is_object()) {
+      code += target + " = " + jx9Literal(patch) + ";";
+      return;
+    }
+    for(const auto& [key, value] : patch.items()) {
+      const auto k = jx9Literal(key);
+      const auto member = target + "[" + k + "]";
+      if(value.is_null()) {
+        code += "if(array_key_exists(" + k + ", " + target + ")) { unset(" + member + "); }";
+      } else if(value.is_object()) {
+        code += "if(!array_key_exists(" + k + ", " + target + ") || !is_array(" + member + ")) { "
+              + member + " = {}; }";
+        jx9MergePatch(value, member, code);
+      } else {
+        code += member + " = " + jx9Literal(value) + ";";
+      }
+    }
+  }
+
+  /**
+   * @brief Applies a JSON Patch, which Jx9 code cannot easily express,
+   * to the documents: they are fetched and patched by the client, once
+   * per occurrence of their id, then a Jx9 script replaces them only
+   * if they all still equal the fetched documents, starting over
+   * otherwise, at most s_swap_attempts times.
+   */
+  void swapPatchedDocs(const uint64_t *ids, size_t count, const json& patch,
+                       bool commit) const {
+    std::vector<uint64_t> unique(ids, ids + count);
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+    std::vector<size_t> repeats(unique.size());
+    for(size_t i = 0; i < count; ++i)
+      ++repeats[std::lower_bound(unique.begin(), unique.end(), ids[i]) - unique.begin()];
+    for(size_t attempt = 0; attempt < s_swap_attempts; ++attempt) {
+      json expected;
+      fetch_multi(unique.data(), unique.size(), &expected, nullptr);
+      json docs = expected;
+      for(size_t i = 0; i < unique.size(); ++i) {
+        if(docs[i].is_null())
+          throw Exception{"Record " + std::to_string(unique[i]) + " does not exist"};
+        for(size_t r = 0; r < repeats[i]; ++r) applyPatch(docs[i], patch);
+      }
+      auto swapped = runScript(
+        "$ids = " + json(unique).dump() + ";"
+        "$expected = " + jx9Literal(expected) + ";"
+        "$docs = " + jx9Literal(docs) + ";"
+        "$swapped = TRUE;"
+        "for($i = 0; $i < count($ids); $i++) {"
+        "  if(db_fetch_by_id(" + jx9Literal(name) + ", $ids[$i]) != $expected[$i]) {"
+        "    $swapped = FALSE; break;"
+        "  }"
+        "}"
+        "if($swapped) {"
+        "  for($i = 0; $i < count($ids); $i++) {"
+        "    db_update_record(" + jx9Literal(name) + ", $ids[$i], $docs[$i]);"
+        "  }"
+        "}", {"swapped"}, commit)["swapped"];
+      if(swapped.is_boolean() && swapped.get<bool>()) return;
+    }
+    throw Exception{"Documents kept being modified concurrently, giving up"};
+  }
+
+  /**
+   * @brief Patches the documents, in chunks of s_chunk_count ids with
+   * up to s_chunk_fanout chunks in flight. Merge patches are applied by
+   * a Jx9 script that updates the documents of a chunk only if they
+   * all exist; JSON Patches by swapPatchedDocs.
+   */
+  void patchDocs(const uint64_t *ids, size_t count, const json& patch, bool commit) const {
+    auto chunks = splitChunks(count, s_chunk_count, std::numeric_limits<size_t>::max(),
+                              [](size_t) { return size_t{0}; });
+    if(isJsonPatch(patch)) {
+      runChunks(chunks, s_chunk_fanout, [&](const Chunk& c) {
+        swapPatchedDocs(ids + c.begin, c.end - c.begin, patch, commit);
+      });
+      return;
+    }
+    std::string merge;
+    jx9MergePatch(patch, "$doc", merge);
+    runChunks(chunks, s_chunk_fanout, [&](const Chunk& c) {
+      auto missing = runScript(
+        "$ids = " + json(std::vector<uint64_t>(ids + c.begin, ids + c.end)).dump() + ";"
+        "$docs = [];"
+        "$missing = -1;"
+        "foreach($ids as $id) {"
+        "  $doc = db_fetch_by_id(" + jx9Literal(name) + ", $id);"
+        "  if($doc == NULL) { $missing = $id; break; }"
+        + merge +
+        "  array_push($docs, $doc);"
+        "}"
+        "if($missing < 0) {"
+        "  for($i = 0; $i < count($ids); $i++) {"
+        "    db_update_record(" + jx9Literal(name) + ", $ids[$i], $docs[$i]);"
+        "  }"
+        "}", {"missing"}, commit)["missing"];
+      if(missing.is_number() && missing.get<int64_t>() >= 0)
+        throw Exception{"Record " + std::to_string(missing.get<int64_t>()) + " does not exist"};
+    });
+  }
+
+  /**
+   * @brief Fetches the projections of the documents with a Jx9 script
+   * run by the provider, in chunks of at most s_chunk_count ids with
+   * up to s_chunk_fanout chunks in flight.
+   */
+  void fetchProjected(const uint64_t *ids, size_t count,
+                      const Projection& projection, json *result) const {
+    const auto project = jx9Project(projection);
+    auto chunks = splitChunks(count, s_chunk_count, std::numeric_limits<size_t>::max(),
+                              [](size_t) { return size_t{0}; });
+    json::array_t docs(count);
+    runChunks(chunks, s_chunk_fanout, [&](const Chunk& c) {
+      auto values = runProjection(
+        "$result = [];"
+        "foreach(" + json(std::vector<uint64_t>(ids + c.begin, ids + c.end)).dump() + " as $id) {"
+        "  $doc = db_fetch_by_id(" + jx9Literal(name) + ", $id);"
+        "  if($doc == NULL) { array_push($result, NULL); continue; }"
+        + project +
+        "  array_push($result, $values);"
+        "}");
+      for(size_t i = c.begin; i < c.end; ++i) {
+        const auto& doc = values.at(i - c.begin);
+        if(doc.is_null())
+          throw Exception{"Record " + std::to_string(ids[i]) + " does not exist"};
+        docs[i] = projection.fromValues(doc);
+      }
+    });
+    if(result) *result = std::move(docs);
+  }
+
+  /**
+   * @brief Increments the field of the documents with a Jx9 script
+   * that updates the documents of a chunk only if the field can be
+   * incremented in all of them, and returns the new values. Chunks
+   * are handled as in patchDocs.
+   */
+  json incrementDocs(const uint64_t *ids, size_t count, const std::string& field,
+                     const json& delta, bool commit) const {
+    if(!delta.is_number())
+      throw Exception{"Increment should be a number"};
+    const auto path = Projection{{field}}.paths()[0];
+    // missing objects along the path are created, and a missing field
+    // counts as 0
+    std::string target = "$doc";
+    std::string navigate;
+    for(size_t i = 0; i < path.size(); ++i) {
+      const auto k = jx9Literal(path[i]);
+      navigate += "if(!is_array(" + target + ")) { $invalid = $id; break; }"
+                  "if(!array_key_exists(" + k + ", " + target + ")) { "
+                + target + "[" + k + "] = " + (i + 1 == path.size() ? "0" : "{}") + "; }";
+      target += "[" + k + "]";
+    }
+    // Jx9 integers wrap around, so integer fields that would overflow
+    // are detected before adding an integer delta
+    std::string overflows = "FALSE";
+    if(delta.is_number_integer()) {
+      if(delta.is_number_unsigned()
+      && delta.get<uint64_t>() > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+        throw Exception{"Increment should fit in a 64-bit signed integer"};
+      const auto d = delta.get<int64_t>();
+      overflows = "is_int(" + target + ") && " + target + (d >= 0
+          ? " > " + std::to_string(std::numeric_limits<int64_t>::max() - d)
+          : " < " + std::to_string(std::numeric_limits<int64_t>::min() - d));
+    }
+    auto chunks = splitChunks(count, s_chunk_count, std::numeric_limits<size_t>::max(),
+                              [](size_t) { return size_t{0}; });
+    json::array_t values(count);
+    runChunks(chunks, s_chunk_fanout, [&](const Chunk& c) {
+      // $docs maps the ids to their documents, so that a repeated id
+      // is incremented once per occurrence
+      auto vars = runScript(
+        "$ids = " + json(std::vector<uint64_t>(ids + c.begin, ids + c.end)).dump() + ";"
+        "$docs = {};"
+        "$values = [];"
+        "$missing = -1;"
+        "$invalid = -1;"
+        "$overflow = -1;"
+        "foreach($ids as $id) {"
+        "  if(array_key_exists($id, $docs)) { $doc = $docs[$id]; }"
+        "  else { $doc = db_fetch_by_id(" + jx9Literal(name) + ", $id); }"
+        "  if($doc == NULL) { $missing = $id; break; }"
+        + navigate +
+        "  if(!is_int(" + target + ") && !is_float(" + target + ")) { $invalid = $id; break; }"
+        "  if(" + overflows + ") { $overflow = $id; break; }"
+        "  " + target + " = " + target + " + " + delta.dump() + ";"
+        "  $docs[$id] = $doc;"
+        "  array_push($values, " + target + ");"
+        "}"
+        "if($missing < 0 && $invalid < 0 && $overflow < 0) {"
+        "  foreach($docs as $id => $doc) {"
+        "    db_update_record(" + jx9Literal(name) + ", $id, $doc);"
+        "  }"
+        "}", {"values", "missing", "invalid", "overflow"}, commit);
+      const auto& missing = vars["missing"];
+      if(missing.is_number() && missing.get<int64_t>() >= 0)
+        throw Exception{"Record " + std::to_string(missing.get<int64_t>()) + " does not exist"};
+      const auto& invalid = vars["invalid"];
+      if(invalid.is_number() && invalid.get<int64_t>() >= 0)
+        throw Exception{"Field \"" + field + "\" of record "
+                        + std::to_string(invalid.get<int64_t>()) + " is not a number"};
+      const auto& overflow = vars["overflow"];
+      if(overflow.is_number() && overflow.get<int64_t>() >= 0)
+        throw Exception{"Incrementing field \"" + field + "\" of record "
+                        + std::to_string(overflow.get<int64_t>()) + " overflows"};
+      const auto& chunk = vars["values"];
+      std::copy(chunk.begin(), chunk.end(), values.begin() + c.begin);
+    });
+    return values;
+  }
+
+  static std::vector<std::string_view> unpack(
+        const char *data, const size_t *sizes, size_t count) {
+    std::vector<std::string_view> records(count);
+    for(size_t i = 0, offset = 0; i < count; ++i) {
+      records[i] = std::string_view{data + offset, sizes[i]};
+      offset += sizes[i];
+    }
+    return records;
+  }
 
 public:
 
-  SonataCollection(sonata::Collection c)
-  : coll(std::move(c)) {}
+  SonataCollection(sonata::Collection c, sonata::Database d, std::string n)
+  : coll(std::move(c))
+  , db(std::move(d))
+  , name(std::move(n)) {}
 
   ~SonataCollection() {}
 
@@ -32,6 +478,7 @@ public:
   }
 
   uint64_t store(const json &record, bool commit) const override {
+    if(!nativeJson()) return store(JsonCodec::current().dump(record), commit);
     return coll.store(record, commit);
   }
 
@@ -52,6 +499,10 @@ public:
 
   void store(const json &record, uint64_t *id, bool commit,
              AsyncRequest *req) const override {
+    if(!nativeJson()) {
+      store(JsonCodec::current().dump(record), id, commit, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.store(record, id, commit, &preq->req);
@@ -74,6 +525,17 @@ public:
 
   void store_multi(const std::vector<std::string> &records, uint64_t *ids,
                    bool commit, AsyncRequest *req) const override {
+    auto chunks = splitChunks(records.size(), s_chunk_count, s_chunk_bytes,
+                              [&records](size_t i) { return records[i].size(); });
+    if(chunks.size() > 1) {
+      run([&records, ids, commit, chunks=std::move(chunks), this]() {
+        std::vector<const char*> ptrs;
+        ptrs.reserve(records.size());
+        for(const auto& r : records) ptrs.push_back(r.c_str());
+        storeChunks(chunks, ptrs.data(), ids, commit);
+      }, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.store_multi(records, ids, commit, &preq->req);
@@ -85,6 +547,23 @@ public:
 
   void store_multi(const json &records, uint64_t *ids,
                    bool commit, AsyncRequest *req) const override {
+    // the size of the records is only known once serialized, so
+    // only arrays with many records are serialized here and chunked,
+    // unless they must go through another codec than Sonata's
+    if(records.is_array() && (!nativeJson() || records.size() > s_chunk_count)) {
+      run([&records, ids, commit, this]() {
+        const auto& codec = JsonCodec::current();
+        std::vector<std::string> docs(records.size());
+        for(size_t i = 0; i < records.size(); ++i) codec.dump(records[i], docs[i]);
+        std::vector<const char*> ptrs;
+        ptrs.reserve(docs.size());
+        for(const auto& d : docs) ptrs.push_back(d.c_str());
+        auto chunks = splitChunks(docs.size(), s_chunk_count, s_chunk_bytes,
+                                  [&docs](size_t i) { return docs[i].size(); });
+        storeChunks(chunks, ptrs.data(), ids, commit);
+      }, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.store_multi(records, ids, commit, &preq->req);
@@ -96,6 +575,14 @@ public:
 
   void store_multi(const char *const *records, size_t count, uint64_t *ids,
                    bool commit, AsyncRequest *req) const {
+    auto chunks = splitChunks(count, s_chunk_count, s_chunk_bytes,
+                              [records](size_t i) { return std::strlen(records[i]); });
+    if(chunks.size() > 1) {
+      run([records, ids, commit, chunks=std::move(chunks), this]() {
+        storeChunks(chunks, records, ids, commit);
+      }, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.store_multi(records, count, ids, commit, &preq->req);
@@ -105,6 +592,36 @@ public:
     }
   }
 
+  void store_multi(const char *data, const size_t *sizes, size_t count,
+                   uint64_t *ids, bool commit, AsyncRequest *req) const override {
+    auto chunks = splitChunks(count, s_chunk_count, s_chunk_bytes,
+                              [sizes](size_t i) { return sizes[i]; });
+    if(chunks.size() > 1) {
+      run([data, sizes, count, ids, commit, chunks=std::move(chunks), this]() {
+        auto records = unpack(data, sizes, count);
+        storeChunks(chunks, records.data(), count, ids, commit);
+      }, req);
+      return;
+    }
+    auto records = unpack(data, sizes, count);
+    store_multi(records.data(), count, ids, commit, req);
+  }
+
+  void store_multi(const std::string_view *records, size_t count,
+                   uint64_t *ids, bool commit, AsyncRequest *req) const override {
+    auto chunks = splitChunks(count, s_chunk_count, s_chunk_bytes,
+                              [records](size_t i) { return records[i].size(); });
+    if(chunks.size() > 1) {
+      run([records, count, ids, commit, chunks=std::move(chunks), this]() {
+        storeChunks(chunks, records, count, ids, commit);
+      }, req);
+      return;
+    }
+    std::vector<const char*> ptrs;
+    auto buffer = nullTerminated(records, count, ptrs);
+    store_multi(ptrs.data(), count, ids, commit, req);
+  }
+
   void fetch(uint64_t id, std::string *result,
              AsyncRequest *req) const override {
     if(req) {
@@ -118,6 +635,14 @@ public:
 
   void fetch(uint64_t id, json *result,
              AsyncRequest *req) const override {
+    if(!nativeJson()) {
+      run([id, result, this]() {
+        std::string doc;
+        coll.fetch(id, &doc);
+        if(result) *result = JsonCodec::current().parse(doc);
+      }, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.fetch(id, result, &preq->req);
@@ -130,6 +655,10 @@ public:
   void fetch_multi(const uint64_t *ids, size_t count,
                    std::vector<std::string> *result,
                    AsyncRequest *req) const override {
+    if(count > s_chunk_count) {
+      run([ids, count, result, this]() { fetchChunks(ids, count, result); }, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.fetch_multi(ids, count, result, &preq->req);
@@ -141,6 +670,19 @@ public:
 
   void fetch_multi(const uint64_t *id, size_t count, json *result,
                    AsyncRequest *req) const override {
+    if(!nativeJson()) {
+      run([id, count, result, this]() {
+        std::vector<std::string> docs;
+        if(count > s_chunk_count) fetchChunks(id, count, &docs);
+        else coll.fetch_multi(id, count, &docs);
+        parseAll(docs, result);
+      }, req);
+      return;
+    }
+    if(count > s_chunk_count) {
+      run([id, count, result, this]() { fetchChunks(id, count, result); }, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.fetch_multi(id, count, result, &preq->req);
@@ -150,6 +692,32 @@ public:
     }
   }
 
+  void fetch_multi(const uint64_t *ids, size_t count, DocumentBatch *result,
+                   AsyncRequest *req) const override {
+    run([ids, count, result, this]() {
+      std::vector<std::string> docs;
+      if(count > s_chunk_count) fetchChunks(ids, count, &docs);
+      else coll.fetch_multi(ids, count, &docs);
+      if(!result) return;
+      result->clear();
+      for(size_t i = 0; i < docs.size() && i < count; ++i) {
+        if(docs[i].empty() || docs[i] == "null") continue;
+        result->push_back(ids[i], docs[i].data(), docs[i].size());
+      }
+    }, req);
+  }
+
+  void filter(const std::string &filterCode, DocumentBatch *result,
+              AsyncRequest *req) const override {
+    run([filterCode, result, this]() {
+      std::vector<std::string> docs;
+      coll.filter(filterCode, &docs);
+      if(!result) return;
+      result->clear();
+      toBatch(docs, result);
+    }, req);
+  }
+
   void filter(const std::string &filterCode, std::vector<std::string> *result,
               AsyncRequest *req) const override {
     if(req) {
@@ -163,6 +731,14 @@ public:
 
   void filter(const std::string &filterCode, json *result,
               AsyncRequest *req) const override {
+    if(!nativeJson()) {
+      run([filterCode, result, this]() {
+        std::vector<std::string> docs;
+        coll.filter(filterCode, &docs);
+        parseAll(docs, result);
+      }, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.filter(filterCode, result, &preq->req);
@@ -174,6 +750,10 @@ public:
 
   void update(uint64_t id, const json &record, bool commit,
               AsyncRequest *req) const override {
+    if(!nativeJson()) {
+      update(id, JsonCodec::current().dump(record), commit, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.update(id, record, commit, &preq->req);
@@ -208,6 +788,13 @@ public:
   void update_multi(const uint64_t *ids, const json &record,
                     std::vector<bool> *updated, bool commit,
                     AsyncRequest *req) const override {
+    if(!nativeJson() && record.is_array()) {
+      const auto& codec = JsonCodec::current();
+      std::vector<std::string> docs(record.size());
+      for(size_t i = 0; i < record.size(); ++i) codec.dump(record[i], docs[i]);
+      update_multi(ids, docs, updated, commit, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.update_multi(ids, record, updated, commit, &preq->req);
@@ -242,6 +829,22 @@ public:
     }
   }
 
+  void update_multi(const uint64_t *ids, const char *data,
+                    const size_t *sizes, size_t count,
+                    std::vector<bool> *updated, bool commit,
+                    AsyncRequest *req) const override {
+    auto records = unpack(data, sizes, count);
+    update_multi(ids, records.data(), count, updated, commit, req);
+  }
+
+  void update_multi(const uint64_t *ids, const std::string_view *records,
+                    size_t count, std::vector<bool> *updated, bool commit,
+                    AsyncRequest *req) const override {
+    std::vector<const char*> ptrs;
+    auto buffer = nullTerminated(records, count, ptrs);
+    update_multi(const_cast<uint64_t*>(ids), ptrs.data(), count, updated, commit, req);
+  }
+
   void all(std::vector<std::string> *result, AsyncRequest *req) const override {
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
@@ -253,6 +856,14 @@ public:
   }
 
   void all(json *result, AsyncRequest *req) const override {
+    if(!nativeJson()) {
+      run([result, this]() {
+        std::vector<std::string> docs;
+        coll.all(&docs);
+        parseAll(docs, result);
+      }, req);
+      return;
+    }
     if(req) {
         auto preq = std::make_shared<SonataAsyncRequest>();
         coll.all(result, &preq->req);
@@ -262,6 +873,166 @@ public:
     }
   }
 
+  void all(DocumentBatch *result, AsyncRequest *req) const override {
+    run([result, this]() {
+      std::vector<std::string> docs;
+      coll.all(&docs);
+      if(!result) return;
+      result->clear();
+      toBatch(docs, result);
+    }, req);
+  }
+
+  void all(const std::function<void(const std::vector<std::string>&)> &callback,
+           size_t batch_size, AsyncRequest *req) const override {
+    // Sonata has no paged listing, so we walk the range of record ids
+    // and fetch them batch by batch, skipping erased records.
+    auto thread = [callback, batch_size, this]() {
+      const uint64_t n = batch_size ? batch_size : 128;
+      const uint64_t last_id = coll.last_record_id();
+      std::vector<uint64_t> ids;
+      std::vector<std::string> batch;
+      ids.reserve(n);
+      for(uint64_t start = 0; start <= last_id; start += n) {
+        ids.clear();
+        for(uint64_t id = start; id <= last_id && id < start + n; id++)
+          ids.push_back(id);
+        batch.clear();
+        coll.fetch_multi(ids.data(), ids.size(), &batch);
+        batch.erase(std::remove_if(batch.begin(), batch.end(),
+              [](const std::string& doc) { return doc.empty() || doc == "null"; }),
+            batch.end());
+        if(!batch.empty()) callback(batch);
+      }
+    };
+    run(std::move(thread), req);
+  }
+
+  /**
+   * @brief Fetches the records of the range with a single Jx9 script,
+   * which serializes them so that they are not parsed by the client,
+   * and returns their ids and documents.
+   */
+  std::pair<json, json> fetchRange(uint64_t first, size_t count) const {
+    auto vars = runScript(
+      "$ids = []; $docs = [];" +
+      jx9ForRange(first, count,
+        "  $doc = db_fetch_by_id(" + jx9Literal(name) + ", $id);"
+        "  if($doc == NULL) { continue; }"
+        "  array_push($ids, $id);"
+        "  array_push($docs, json_encode($doc));"),
+      {"ids", "docs"}, false);
+    return {std::move(vars["ids"]), std::move(vars["docs"])};
+  }
+
+  void fetch_range(uint64_t first, size_t count, std::vector<std::string> *result,
+                   AsyncRequest *req) const override {
+    // Sonata has no range query, so a script run by the provider
+    // loops over the ids, skipping erased records.
+    run([first, count, result, this]() {
+      if(count == 0) {
+        if(result) result->clear();
+        return;
+      }
+      auto range = fetchRange(first, count);
+      if(!result) return;
+      result->clear();
+      for(auto& doc : range.second) result->push_back(std::move(doc.get_ref<std::string&>()));
+    }, req);
+  }
+
+  void fetch_range(uint64_t first, size_t count, DocumentBatch *result,
+                   AsyncRequest *req) const override {
+    run([first, count, result, this]() {
+      if(result) result->clear();
+      if(count == 0) return;
+      auto range = fetchRange(first, count);
+      if(!result) return;
+      for(size_t i = 0; i < range.first.size(); ++i) {
+        const auto& doc = range.second[i].get_ref<const std::string&>();
+        result->push_back(range.first[i].get<uint64_t>(), doc.data(), doc.size());
+      }
+    }, req);
+  }
+
+  void erase_range(uint64_t first, size_t count, bool commit,
+                   AsyncRequest *req) const override {
+    // Jx9 ignores the ids of records that do not exist.
+    run([first, count, commit, this]() {
+      if(count == 0) return;
+      runScript(jx9ForRange(first, count,
+                            "  db_drop_record(" + jx9Literal(name) + ", $id);"),
+                {}, commit);
+    }, req);
+  }
+
+  void fetch(uint64_t id, const std::vector<std::string> &fields,
+             json *result, AsyncRequest *req) const override {
+    Projection projection{fields};
+    run([id, projection = std::move(projection), result, this]() {
+      json docs;
+      fetchProjected(&id, 1, projection, &docs);
+      if(result) *result = std::move(docs[0]);
+    }, req);
+  }
+
+  void fetch_multi(const uint64_t *ids, size_t count,
+                   const std::vector<std::string> &fields,
+                   json *result, AsyncRequest *req) const override {
+    Projection projection{fields};
+    run([ids, count, projection = std::move(projection), result, this]() {
+      fetchProjected(ids, count, projection, result);
+    }, req);
+  }
+
+  void filter(const std::string &filterCode, const std::vector<std::string> &fields,
+              json *result, AsyncRequest *req) const override {
+    Projection projection{fields};
+    run([filterCode, projection = std::move(projection), result, this]() {
+      // an empty filter code selects all the records
+      const auto docsCode = filterCode.empty()
+        ? "db_fetch_all(" + jx9Literal(name) + ")"
+        : "db_fetch_all(" + jx9Literal(name) + ", $filter)";
+      auto values = runProjection(
+        (filterCode.empty() ? std::string{} : "$filter = " + filterCode + ";") +
+        "$result = [];"
+        "foreach(" + docsCode + " as $doc) {"
+        + jx9Project(projection) +
+        "  array_push($result, $values);"
+        "}");
+      auto docs = json::array();
+      for(const auto& doc : values) docs.push_back(projection.fromValues(doc));
+      if(result) *result = std::move(docs);
+    }, req);
+  }
+
+  void patch(uint64_t id, const json &patch, bool commit,
+             AsyncRequest *req) const override {
+    run([id, patch, commit, this]() { patchDocs(&id, 1, patch, commit); }, req);
+  }
+
+  void patch_multi(const uint64_t *ids, size_t count, const json &patch,
+                   bool commit, AsyncRequest *req) const override {
+    run([ids, count, patch, commit, this]() { patchDocs(ids, count, patch, commit); }, req);
+  }
+
+  void increment(uint64_t id, const std::string &field, const json &delta,
+                 json *result, bool commit, AsyncRequest *req) const override {
+    run([id, field, delta, result, commit, this]() {
+      auto values = incrementDocs(&id, 1, field, delta, commit);
+      if(result) *result = std::move(values[0]);
+    }, req);
+  }
+
+  void increment_multi(const uint64_t *ids, size_t count,
+                       const std::string &field, const json &delta,
+                       json *result, bool commit, AsyncRequest *req) const override {
+    run([ids, count, field, delta, result, commit, this]() {
+      auto values = incrementDocs(ids, count, field, delta, commit);
+      if(result) *result = std::move(values);
+    }, req);
+  }
+
   uint64_t last_record_id() const override {
     return coll.last_record_id();
   }
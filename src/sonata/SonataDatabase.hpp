@@ -5,6 +5,7 @@
  */
 #include "SonataCollection.hpp"
 #include <isonata/Database.hpp>
+#include <isonata/DocumentFormat.hpp>
 #include <sonata/Database.hpp>
 
 namespace isonata {
@@ -24,7 +25,16 @@ public:
   ~SonataDatabase() {}
 
   Collection create(const std::string &collectionName) const override {
-    return Collection{std::make_shared<SonataCollection>(db.create(collectionName))};
+    return Collection{std::make_shared<SonataCollection>(
+        db.create(collectionName), db, collectionName)};
+  }
+
+  Collection create(const std::string &collectionName, const json &options) const override {
+    if(format_option(options) != DocumentFormat::JSON)
+      throw Exception{"Sonata collections can only store JSON documents"};
+    if(options.is_object() && options.contains("compression"))
+      throw Exception{"Sonata collections do not support compression"};
+    return create(collectionName);
   }
 
   bool exists(const std::string &collectionName) const override {
@@ -32,7 +42,8 @@ public:
   }
 
   Collection open(const std::string &collectionName, bool check) const override {
-    return Collection{std::make_shared<SonataCollection>(db.open(collectionName, check))};
+    return Collection{std::make_shared<SonataCollection>(
+        db.open(collectionName, check), db, collectionName)};
   }
 
   void drop(const std::string &collectionName) const override {
@@ -0,0 +1,45 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_YOKAN_PROVIDER_FORMAT_HPP
+#define __ISONATA_YOKAN_PROVIDER_FORMAT_HPP
+
+#include <isonata/DocumentFormat.hpp>
+#include <string>
+#include <string_view>
+
+namespace isonata {
+
+/**
+ * @brief Decodes a document stored in the given format. Unlike
+ * decode, this function uses nlohmann::json for JSON text, since
+ * JsonCodec is not available on the provider side.
+ */
+inline json parseStored(DocumentFormat format, std::string_view doc) {
+    switch(format) {
+      case DocumentFormat::CBOR:        return json::from_cbor(doc.begin(), doc.end());
+      case DocumentFormat::MessagePack: return json::from_msgpack(doc.begin(), doc.end());
+      case DocumentFormat::BSON:        return json::from_bson(doc.begin(), doc.end());
+      default:                          return json::parse(doc.begin(), doc.end());
+    }
+}
+
+/**
+ * @brief Encodes the value in the given format into out, with
+ * nlohmann::json for JSON text (see parseStored).
+ */
+inline void dumpStored(DocumentFormat format, const json& value, std::string& out) {
+    out.clear();
+    switch(format) {
+      case DocumentFormat::CBOR:        json::to_cbor(value, out); break;
+      case DocumentFormat::MessagePack: json::to_msgpack(value, out); break;
+      case DocumentFormat::BSON:        json::to_bson(value, out); break;
+      default:                          out = value.dump(); break;
+    }
+}
+
+} // namespace isonata
+
+#endif
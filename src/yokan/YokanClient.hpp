@@ -12,14 +12,44 @@ namespace isonata {
 
 class YokanClient : public AbstractClientImpl {
 
-  tl::engine    m_engine;
-  yokan::Client m_client;
+  tl::engine                      m_engine;
+  yokan::Client                   m_client;
+  std::shared_ptr<YokanWorkQueue> m_queue;
+
+  static size_t getCount(const json& config, const char* field, size_t default_value) {
+      if(!config.contains(field)) return default_value;
+      const auto& value = config[field];
+      if(!value.is_number_unsigned())
+          throw Exception{std::string{"\"async."} + field + "\" should be an unsigned integer"};
+      return value.get<size_t>();
+  }
+
+  static std::shared_ptr<YokanWorkQueue> makeQueue(const tl::engine& engine,
+                                                   const json& config) {
+      json async = json::object();
+      if(config.is_object() && config.contains("async")) async = config["async"];
+      if(!async.is_object())
+          throw Exception{"\"async\" field in client configuration should be an object"};
+      auto num_xstreams = getCount(async, "num_xstreams", YokanWorkQueue::s_default_num_xstreams);
+      auto num_workers  = getCount(async, "num_workers", YokanWorkQueue::s_default_num_workers);
+      auto num_serializers = getCount(async, "num_serializers", num_xstreams ? num_xstreams : 1);
+      if(num_xstreams == 0)
+          return std::make_shared<YokanWorkQueue>(
+              engine.get_progress_pool(), num_workers, num_serializers);
+      return std::make_shared<YokanWorkQueue>(num_xstreams, num_workers, num_serializers);
+  }
 
 public:
 
-  YokanClient(const tl::engine& engine)
+  YokanClient(const tl::engine& engine, const json& config = json::object())
+  : m_engine(engine)
+  , m_client(engine.get_margo_instance())
+  , m_queue(makeQueue(engine, config)) {}
+
+  YokanClient(const tl::engine& engine, const tl::pool& pool)
   : m_engine(engine)
-  , m_client(engine.get_margo_instance()) {}
+  , m_client(engine.get_margo_instance())
+  , m_queue(std::make_shared<YokanWorkQueue>(pool)) {}
 
   ~YokanClient() {}
 
@@ -33,14 +63,15 @@ public:
       (void)check;
       auto ep = m_engine.lookup(address);
       auto db = m_client.findDatabaseByName(ep.get_addr(), provider_id, db_name.c_str());
-      return Database{std::make_shared<YokanDatabase>(m_engine, db)};
+      return Database{std::make_shared<YokanDatabase>(
+          m_engine, m_queue, db, tl::provider_handle{ep, provider_id}, db_name)};
   }
 
   Database open(
         const ProviderHandle &ph, const std::string &db_name,
         bool check) const override {
       auto db = m_client.findDatabaseByName(ph.get_addr(), ph.provider_id(), db_name.c_str());
-      return Database{std::make_shared<YokanDatabase>(m_engine, db)};
+      return Database{std::make_shared<YokanDatabase>(m_engine, m_queue, db, ph, db_name)};
   }
 
   ProviderHandle createProviderHandle(
@@ -4,26 +4,647 @@
  * See COPYRIGHT in top-level directory.
  */
 #include <isonata/Collection.hpp>
+#include <isonata/DocumentBatch.hpp>
+#include <isonata/DocumentFormat.hpp>
 #include <isonata/Exception.hpp>
-#include "YokanAsyncRequest.hpp"
+#include "YokanWorkQueue.hpp"
+#include "../DocumentCompressor.hpp"
+#include "../ChunkedOperation.hpp"
+#include "../Patch.hpp"
+#include "../Projection.hpp"
 #include <yokan/cxx/collection.hpp>
+#include <yokan/cxx/exception.hpp>
+#include <thallium/serialization/stl/pair.hpp>
+#include <thallium/serialization/stl/string.hpp>
+#include <thallium/serialization/stl/vector.hpp>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <utility>
 
 namespace isonata {
 
 namespace tl = thallium;
 using nlohmann::json;
 
+/**
+ * @brief RPCs of the YokanPatchProvider that the ISonata provider
+ * registers next to the Yokan provider, with the handle of that
+ * provider and the name of the database.
+ */
+struct YokanPatchRPC {
+  tl::remote_procedure patch;
+  tl::remote_procedure increment;
+  tl::remote_procedure swap;
+  tl::provider_handle  provider;
+  std::string          db_name;
+};
+
 class YokanCollection : public AbstractCollectionImpl {
 
-  tl::engine        m_engine;
-  yokan::Collection m_coll;
+  tl::engine                                m_engine;
+  std::shared_ptr<YokanWorkQueue>           m_queue;
+  DocumentFormat                            m_format;
+  std::shared_ptr<const DocumentCompressor> m_compressor;
+  std::shared_ptr<const YokanPatchRPC>      m_patch;
+  std::string                               m_name;
+  yokan::Collection                         m_coll;
+  mutable std::atomic<size_t> m_size_hint{s_initial_size_hint};
+  mutable std::atomic<size_t> m_size_max{s_initial_size_hint};
+  mutable std::atomic<bool>   m_client_projection{false};
+
+  static constexpr size_t s_page_count = 128;
+  static constexpr size_t s_page_bytes = 1024*1024;
+  static constexpr size_t s_initial_size_hint = 1024;
+  static constexpr size_t s_min_packed_bytes = 16*1024;
+  static constexpr size_t s_max_packed_bytes = 16*1024*1024;
+  static constexpr size_t s_erase_chunk = 4096;
+  static constexpr size_t s_chunk_count = 4096;
+  static constexpr size_t s_chunk_bytes = 4*1024*1024;
+  static constexpr size_t s_chunk_fanout = 4;
+  static constexpr size_t s_projection_gap = 64;
+
+  static constexpr size_t s_swap_attempts = 16;
+
+  static uint64_t rangeEnd(uint64_t first, size_t count) {
+      return count > std::numeric_limits<uint64_t>::max() - first
+           ? std::numeric_limits<uint64_t>::max() : first + count;
+  }
+
+  /**
+   * @brief Whether the collection stores uncompressed JSON text, in
+   * which case documents are stored and fetched without conversion.
+   */
+  bool storesText() const {
+      return m_format == DocumentFormat::JSON && !m_compressor;
+  }
+
+  /**
+   * @brief Encodes the value as stored by the collection into out:
+   * in the storage format, then compressed if the collection
+   * has a compressor.
+   */
+  void encodeDoc(const json& value, std::string& out) const {
+      if(!m_compressor) {
+          encode(m_format, value, out);
+          return;
+      }
+      std::string encoded;
+      encode(m_format, value, encoded);
+      m_compressor->compress(encoded, out);
+  }
+
+  /**
+   * @brief Decodes a document as stored by the collection.
+   */
+  json decodeDoc(std::string_view doc) const {
+      if(!m_compressor) return decode(m_format, doc);
+      std::string encoded;
+      m_compressor->decompress(doc, encoded);
+      return decode(m_format, encoded);
+  }
+
+  /**
+   * @brief Returns the JSON text document as stored by the collection:
+   * the text itself if the collection stores text, otherwise the
+   * document converted into buf.
+   */
+  std::string_view toStored(std::string_view text, std::string& buf) const {
+      if(storesText()) return text;
+      if(m_format == DocumentFormat::JSON)
+          m_compressor->compress(text, buf);
+      else
+          encodeDoc(JsonCodec::current().parse(text), buf);
+      return buf;
+  }
+
+  /**
+   * @brief Same as above for the count documents returned by text(i),
+   * filling documents and sizes. Documents are converted in parallel
+   * into encoded if the collection does not store text.
+   */
+  template<typename Text>
+  void toStored(size_t count, Text&& text, std::vector<std::string>& encoded,
+                std::vector<const void*>& documents, std::vector<size_t>& sizes) const {
+      documents.resize(count);
+      sizes.resize(count);
+      if(storesText()) {
+          for(size_t i = 0; i < count; ++i) {
+              std::string_view doc = text(i);
+              documents[i] = doc.data();
+              sizes[i]     = doc.size();
+          }
+          return;
+      }
+      encoded.resize(count);
+      m_queue->parallel_for(count, [&](size_t i) {
+          auto doc = toStored(text(i), encoded[i]);
+          documents[i] = doc.data();
+          sizes[i]     = doc.size();
+      });
+  }
+
+  /**
+   * @brief Converts a stored document into JSON text.
+   */
+  std::string toText(std::string_view doc) const {
+      if(storesText()) return std::string{doc};
+      if(m_format != DocumentFormat::JSON)
+          return JsonCodec::current().dump(decodeDoc(doc));
+      std::string text;
+      m_compressor->decompress(doc, text);
+      return text;
+  }
+
+  /**
+   * @brief Converts the stored documents of the batch into JSON text,
+   * appending them to out.
+   */
+  void toText(const DocumentBatch& batch, std::vector<std::string>& out) const {
+      const auto first = out.size();
+      out.resize(first + batch.size());
+      if(storesText()) {
+          for(size_t i = 0; i < batch.size(); ++i) out[first + i].assign(batch[i]);
+          return;
+      }
+      m_queue->parallel_for(batch.size(), [&](size_t i) {
+          out[first + i] = toText(batch[i]);
+      });
+  }
+
+  /**
+   * @brief Converts the stored documents of the batch into JSON text.
+   */
+  void toText(DocumentBatch& batch) const {
+      if(storesText() || batch.empty()) return;
+      std::vector<std::string> texts;
+      toText(batch, texts);
+      DocumentBatch result;
+      result.reserve(texts.size(), batch.bytes());
+      for(size_t i = 0; i < texts.size(); ++i)
+          result.push_back(batch.id(i), texts[i].data(), texts[i].size());
+      batch = std::move(result);
+  }
+
+  /**
+   * @brief Offsets of count documents packed contiguously.
+   */
+  static std::vector<size_t> packedOffsets(const size_t* sizes, size_t count) {
+      std::vector<size_t> offsets(count);
+      for(size_t i = 1; i < count; ++i) offsets[i] = offsets[i-1] + sizes[i-1];
+      return offsets;
+  }
+
+  /**
+   * @brief Loads the documents with the given ids and appends them,
+   * in order, to the batch. The documents are loaded with a single
+   * loadPacked RPC directly into the batch's buffer, sized for count
+   * documents of the running average size (m_size_hint) plus one of
+   * the largest recent size (m_size_max), so that a document larger
+   * than average, which would otherwise push it and the following
+   * documents out of the buffer, still fits. The buffer is at least
+   * s_min_packed_bytes, which covers small fetches of small documents
+   * whatever their mix, and at most s_max_packed_bytes. Only documents
+   * that did not fit are loaded again after querying their size.
+   * Missing documents are either skipped or reported with an exception.
+   */
+  void loadDocs(const uint64_t* ids, size_t count, DocumentBatch& batch,
+                bool skip_missing) const {
+      if(count == 0) return;
+      std::vector<size_t> sizes(count);
+      std::vector<size_t> offsets(count);
+      const auto hint = std::max<size_t>(m_size_hint.load(), 1);
+      const auto bufsize = std::clamp(std::min(count, s_max_packed_bytes/hint)*hint
+                                      + m_size_max.load(),
+                                      s_min_packed_bytes, s_max_packed_bytes);
+      m_coll.loadPacked(count, ids, bufsize, batch.write_area(bufsize), sizes.data());
+      std::vector<size_t> missing;
+      size_t packed = 0;
+      for(size_t i = 0; i < count; ++i) {
+          if(sizes[i] == YOKAN_SIZE_TOO_SMALL) {
+              missing.push_back(i);
+          } else if(sizes[i] == YOKAN_KEY_NOT_FOUND) {
+              if(!skip_missing)
+                  throw Exception{"Record " + std::to_string(ids[i]) + " does not exist"};
+          } else {
+              offsets[i] = packed;
+              packed += sizes[i];
+          }
+      }
+      const auto base = batch.append_bytes(packed);
+      for(auto& offset : offsets) offset += base;
+      size_t total = 0;
+      if(!missing.empty()) {
+          std::vector<uint64_t> missing_ids;
+          std::vector<size_t>   missing_sizes(missing.size());
+          missing_ids.reserve(missing.size());
+          for(auto i : missing) missing_ids.push_back(ids[i]);
+          m_coll.lengthMulti(missing.size(), missing_ids.data(), missing_sizes.data());
+          for(auto size : missing_sizes)
+              if(size != YOKAN_KEY_NOT_FOUND) total += size;
+          auto area = batch.write_area(total);
+          std::vector<void*> ptrs(missing.size());
+          for(size_t j = 0, offset = 0; j < missing.size(); ++j) {
+              ptrs[j] = area + offset;
+              if(missing_sizes[j] != YOKAN_KEY_NOT_FOUND) offset += missing_sizes[j];
+          }
+          m_coll.loadMulti(missing.size(), missing_ids.data(), ptrs.data(), missing_sizes.data());
+          const auto missing_base = batch.append_bytes(total);
+          for(size_t j = 0, offset = 0; j < missing.size(); ++j) {
+              const auto i = missing[j];
+              sizes[i] = missing_sizes[j];
+              if(sizes[i] == YOKAN_KEY_NOT_FOUND) {
+                  if(!skip_missing)
+                      throw Exception{"Record " + std::to_string(ids[i]) + " does not exist"};
+                  continue;
+              }
+              offsets[i] = missing_base + offset;
+              offset += sizes[i];
+          }
+      }
+      size_t loaded = 0;
+      size_t largest = 0;
+      for(size_t i = 0; i < count; ++i) {
+          if(sizes[i] == YOKAN_KEY_NOT_FOUND) continue;
+          batch.add(ids[i], offsets[i], sizes[i]);
+          largest = std::max(largest, sizes[i]);
+          ++loaded;
+      }
+      if(loaded) updateSizeHint((packed + total)/loaded + 1, largest);
+  }
+
+  /**
+   * @brief Moves the document size estimate a quarter of the way
+   * towards the average size of the documents just loaded, so that it
+   * follows the sizes of the documents in both directions, and keeps
+   * the largest recent size, decaying by a sixteenth per load so that
+   * a single outlier is eventually forgotten.
+   */
+  void updateSizeHint(size_t avg, size_t largest) const {
+      auto hint = m_size_hint.load();
+      size_t next;
+      do {
+          next = hint - hint/4 + avg/4;
+      } while(next != hint && !m_size_hint.compare_exchange_weak(hint, next));
+      auto max = m_size_max.load();
+      do {
+          next = std::max(largest, max - max/16);
+      } while(next != max && !m_size_max.compare_exchange_weak(max, next));
+  }
+
+  /**
+   * @brief Loads the documents as loadDocs does. Requests for more
+   * documents than fit in s_chunk_bytes according to the size estimate
+   * (or more than s_chunk_count documents) are split into chunks loaded
+   * by up to s_chunk_fanout concurrent ULTs, and appended in order.
+   */
+  void loadChunked(const uint64_t* ids, size_t count, DocumentBatch& batch,
+                   bool skip_missing) const {
+      const auto per_chunk = std::clamp<size_t>(
+          s_chunk_bytes / std::max<size_t>(m_size_hint.load(), 1), 1, s_chunk_count);
+      if(count <= per_chunk) {
+          loadDocs(ids, count, batch, skip_missing);
+          return;
+      }
+      auto chunks = splitChunks(count, per_chunk, std::numeric_limits<size_t>::max(),
+                                [](size_t) { return size_t{0}; });
+      std::vector<DocumentBatch> parts(chunks.size());
+      runChunks(chunks, s_chunk_fanout, [&](const Chunk& c) {
+          loadDocs(ids + c.begin, c.end - c.begin, parts[c.index], skip_missing);
+      });
+      for(const auto& part : parts) batch.append(part);
+  }
+
+  /**
+   * @brief Stores the documents with storeMulti. Batches of more than
+   * s_chunk_count documents or s_chunk_bytes bytes are split into
+   * chunks stored by up to s_chunk_fanout concurrent ULTs, each chunk
+   * writing its ids at its position in ids. If a chunk fails, the
+   * chunks already stored are erased before the error is reported, so
+   * the batch is still stored entirely or not at all, but other clients
+   * may read the documents of a chunk before they are erased, and the
+   * ids of different chunks are not ordered.
+   */
+  void storeDocs(size_t count, const void* const* docs, const size_t* sizes,
+                 uint64_t* ids) const {
+      auto chunks = splitChunks(count, s_chunk_count, s_chunk_bytes,
+                                [sizes](size_t i) { return sizes[i]; });
+      if(chunks.size() <= 1) {
+          m_coll.storeMulti(count, docs, sizes, ids);
+          return;
+      }
+      std::vector<uint64_t> local;
+      if(!ids) {
+          local.resize(count);
+          ids = local.data();
+      }
+      runChunks(chunks, s_chunk_fanout,
+          [&](const Chunk& c) {
+              m_coll.storeMulti(c.end - c.begin, docs + c.begin, sizes + c.begin, ids + c.begin);
+          },
+          [&](const Chunk& c) {
+              m_coll.eraseMulti(c.end - c.begin, ids + c.begin);
+          });
+  }
+
+  /**
+   * @brief Same as storeDocs for documents packed contiguously in data.
+   */
+  void storePackedDocs(size_t count, const char* data, const size_t* sizes,
+                       uint64_t* ids) const {
+      auto chunks = splitChunks(count, s_chunk_count, s_chunk_bytes,
+                                [sizes](size_t i) { return sizes[i]; });
+      if(chunks.size() <= 1) {
+          m_coll.storePacked(count, data, sizes, ids);
+          return;
+      }
+      std::vector<size_t> offsets(chunks.size());
+      for(size_t j = 1; j < chunks.size(); ++j) {
+          offsets[j] = offsets[j-1];
+          for(auto i = chunks[j-1].begin; i < chunks[j-1].end; ++i) offsets[j] += sizes[i];
+      }
+      std::vector<uint64_t> local;
+      if(!ids) {
+          local.resize(count);
+          ids = local.data();
+      }
+      runChunks(chunks, s_chunk_fanout,
+          [&](const Chunk& c) {
+              m_coll.storePacked(c.end - c.begin, data + offsets[c.index],
+                                 sizes + c.begin, ids + c.begin);
+          },
+          [&](const Chunk& c) {
+              m_coll.eraseMulti(c.end - c.begin, ids + c.begin);
+          });
+  }
+
+  /**
+   * @brief Lists the documents of the collection in pages of at most
+   * page_count documents, appending each page to the batch and calling
+   * callback(batch, first) where first is the index of the first
+   * document of the page. The callback may clear the batch to keep a
+   * single page in memory. If the filter is not empty, it is sent to
+   * the provider with filter_mode (a Lua filter by default) so that
+   * only matching documents are transferred. Lua filters see the
+   * stored bytes, so they are rejected on collections that do not
+   * store JSON text (compressed or binary documents). Only documents
+   * with ids in [start_id, end_id) are listed; since ids are dense, a
+   * page never requests more documents than there are ids left in the
+   * range.
+   */
+  template<typename Callback>
+  void listDocs(const std::string& filter, size_t page_count,
+                DocumentBatch& batch, Callback&& callback,
+                yk_id_t start_id = 0,
+                yk_id_t end_id = std::numeric_limits<yk_id_t>::max(),
+                int32_t filter_mode = YOKAN_MODE_LUA_FILTER) const {
+      if(!filter.empty() && filter_mode == YOKAN_MODE_LUA_FILTER && !storesText())
+          throw Exception{"Filters are not supported on collections storing "
+                          "compressed or binary documents"};
+      int32_t mode = YOKAN_MODE_INCLUSIVE;
+      if(!filter.empty()) mode |= filter_mode;
+      if(page_count == 0) page_count = s_page_count;
+      std::vector<yk_id_t> ids(page_count);
+      std::vector<size_t>  sizes(page_count);
+      size_t  page_bytes = s_page_bytes;
+      bool done = start_id >= end_id;
+      while(!done) {
+          const size_t count = std::min<yk_id_t>(page_count, end_id - start_id);
+          m_coll.listDocsPacked(start_id, filter.data(), filter.size(),
+                                count, ids.data(), page_bytes,
+                                batch.write_area(page_bytes), sizes.data(), mode);
+          const auto first = batch.size();
+          const auto base  = batch.bytes();
+          size_t offset = 0;
+          for(size_t i = 0; i < count; ++i) {
+              if(ids[i] == YOKAN_NO_MORE_DOCS || sizes[i] == YOKAN_NO_MORE_DOCS
+              || ids[i] >= end_id) {
+                  done = true;
+                  break;
+              }
+              if(sizes[i] == YOKAN_SIZE_TOO_SMALL) break;
+              batch.add(ids[i], base + offset, sizes[i]);
+              offset += sizes[i];
+              start_id = ids[i] + 1;
+          }
+          batch.append_bytes(offset);
+          if(start_id >= end_id) done = true;
+          if(batch.size() == first) {
+              // the next document does not fit in the buffer
+              if(!done) page_bytes *= 2;
+              continue;
+          }
+          callback(batch, first);
+      }
+  }
+
+  /**
+   * @brief Filter string selecting the isonata_projection document
+   * filter that the ISonata provider registers (see YokanFilters.hpp),
+   * to use with YOKAN_MODE_LIB_FILTER. The empty library name tells
+   * Yokan that the filter is already registered.
+   */
+  std::string projectionFilter(const Projection& projection,
+                               const json& ids, uint64_t last) const {
+      json args = {
+          {"fields", projection.fields()},
+          {"format", format_name(m_format)},
+          {"last", last}
+      };
+      if(!ids.empty()) args["ids"] = ids;
+      return ":isonata_projection:" + args.dump();
+  }
+
+  /**
+   * @brief Calls on_provider, which projects documents with the
+   * isonata_projection filter, unless the documents are compressed or
+   * the provider turned out not to have that filter (e.g. a plain
+   * Yokan provider), in which case on_client is called to project the
+   * documents on the client. When on_provider fails because Yokan
+   * does not know the filter (YOKAN_ERR_INVALID_FILTER), on_client is
+   * called instead, and if that succeeds later projections go directly
+   * to on_client. Other errors, e.g. RPC failures, are rethrown.
+   */
+  template<typename OnProvider, typename OnClient>
+  void project(OnProvider&& on_provider, OnClient&& on_client) const {
+      if(m_compressor || m_client_projection) {
+          on_client();
+          return;
+      }
+      try {
+          on_provider();
+      } catch(const yokan::Exception& ex) {
+          if(ex.code() != YOKAN_ERR_INVALID_FILTER) throw;
+          on_client();
+          m_client_projection = true;
+      }
+  }
+
+  /**
+   * @brief Lists the projections of the documents with the given ids,
+   * reduced by the provider, as (id, document) pairs in id order.
+   * The sorted ids are split into groups of ids at most
+   * s_projection_gap apart, each group being listed from its first id
+   * to its last one (selecting only its ids if it is not contiguous),
+   * by up to s_chunk_fanout concurrent ULTs.
+   */
+  std::vector<std::pair<uint64_t, json>> listProjected(
+        std::vector<uint64_t> ids, const Projection& projection) const {
+      std::sort(ids.begin(), ids.end());
+      ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+      std::vector<Chunk> groups;
+      for(size_t i = 0, begin = 0; i < ids.size(); ++i) {
+          if(i + 1 == ids.size() || ids[i+1] - ids[i] > s_projection_gap
+          || i + 1 - begin == s_chunk_count) {
+              groups.push_back(Chunk{groups.size(), begin, i + 1});
+              begin = i + 1;
+          }
+      }
+      std::vector<std::vector<std::pair<uint64_t, json>>> parts(groups.size());
+      runChunks(groups, s_chunk_fanout, [&](const Chunk& g) {
+          const auto first = ids[g.begin];
+          const auto last  = ids[g.end - 1];
+          const bool contiguous = last - first + 1 == g.end - g.begin;
+          const auto filter = projectionFilter(projection,
+              contiguous ? json::array() : json(std::vector<uint64_t>(
+                  ids.begin() + g.begin, ids.begin() + g.end)), last);
+          DocumentBatch batch;
+          auto& docs = parts[g.index];
+          listDocs(filter, std::min(g.end - g.begin, s_page_count), batch,
+                   [&docs, this](DocumentBatch& page, size_t) {
+              for(size_t i = 0; i < page.size(); ++i)
+                  docs.emplace_back(page.id(i), decode(m_format, page[i]));
+              page.clear();
+          }, first, rangeEnd(last, 1), YOKAN_MODE_LIB_FILTER);
+      });
+      std::vector<std::pair<uint64_t, json>> result;
+      result.reserve(ids.size());
+      for(auto& part : parts)
+          std::move(part.begin(), part.end(), std::back_inserter(result));
+      return result;
+  }
+
+  /**
+   * @brief Calls modify(doc) on the documents, once per occurrence of
+   * their id, for documents that the provider cannot decode: the
+   * documents are loaded, modified and encoded here, then replaced by
+   * the isonata_yokan_swap RPC only if no other client changed them in
+   * the meantime, starting over otherwise, at most s_swap_attempts
+   * times.
+   */
+  template<typename Modify>
+  void swapDocs(const uint64_t* ids, size_t count, Modify&& modify) const {
+      std::vector<uint64_t> unique(ids, ids + count);
+      std::sort(unique.begin(), unique.end());
+      unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+      std::vector<size_t> repeats(unique.size());
+      for(size_t i = 0; i < count; ++i)
+          ++repeats[std::lower_bound(unique.begin(), unique.end(), ids[i]) - unique.begin()];
+      for(size_t attempt = 0; attempt < s_swap_attempts; ++attempt) {
+          DocumentBatch batch;
+          loadChunked(unique.data(), unique.size(), batch, false);
+          std::vector<std::string> expected(unique.size());
+          std::vector<std::string> replacement(unique.size());
+          m_queue->parallel_for(unique.size(), [&](size_t i) {
+              expected[i] = std::string{batch[i]};
+              auto doc = decodeDoc(batch[i]);
+              for(size_t r = 0; r < repeats[i]; ++r) modify(doc);
+              encodeDoc(doc, replacement[i]);
+          });
+          std::pair<std::string, bool> response = m_patch->swap.on(m_patch->provider)(
+              m_patch->db_name, m_name, unique, expected, replacement);
+          if(!response.first.empty()) throw Exception{response.first};
+          if(response.second) return;
+      }
+      throw Exception{"Documents kept being modified concurrently, giving up"};
+  }
+
+  /**
+   * @brief Patches the documents. The provider patches uncompressed
+   * documents with the isonata_yokan_patch RPC (see
+   * YokanPatchProvider), and compressed ones are patched with
+   * swapDocs, in chunks of s_chunk_count ids sent by up to
+   * s_chunk_fanout concurrent ULTs. Either way, a failing chunk is not
+   * updated at all but the other chunks may be.
+   */
+  void patchDocs(const uint64_t* ids, size_t count, const json& patch) const {
+      auto chunks = splitChunks(count, s_chunk_count, std::numeric_limits<size_t>::max(),
+                                [](size_t) { return size_t{0}; });
+      if(m_compressor) {
+          runChunks(chunks, s_chunk_fanout, [&](const Chunk& c) {
+              swapDocs(ids + c.begin, c.end - c.begin,
+                       [&patch](json& doc) { applyPatch(doc, patch); });
+          });
+          return;
+      }
+      const auto text = patch.dump();
+      runChunks(chunks, s_chunk_fanout, [&](const Chunk& c) {
+          std::string error = m_patch->patch.on(m_patch->provider)(
+              m_patch->db_name, m_name, format_name(m_format),
+              std::vector<uint64_t>(ids + c.begin, ids + c.end), text);
+          if(!error.empty()) throw Exception{error};
+      });
+  }
+
+  /**
+   * @brief Increments the field of the documents with the
+   * isonata_yokan_increment RPC (see YokanPatchProvider), in chunks
+   * as patchDocs does, and returns the new values.
+   */
+  json incrementDocs(const uint64_t* ids, size_t count,
+                     const std::string& field, const json& delta) const {
+      if(m_compressor)
+          throw Exception{"Compressed collections do not support increments"};
+      if(!delta.is_number())
+          throw Exception{"Increment should be a number"};
+      const auto pointer = Projection{{field}}.fields()[0].get<std::string>();
+      const auto text = delta.dump();
+      auto chunks = splitChunks(count, s_chunk_count, std::numeric_limits<size_t>::max(),
+                                [](size_t) { return size_t{0}; });
+      json::array_t values(count);
+      runChunks(chunks, s_chunk_fanout, [&](const Chunk& c) {
+          std::pair<std::string, std::string> response =
+              m_patch->increment.on(m_patch->provider)(
+                  m_patch->db_name, m_name, format_name(m_format),
+                  std::vector<uint64_t>(ids + c.begin, ids + c.end), pointer, text);
+          if(!response.first.empty()) throw Exception{response.first};
+          auto chunk = json::parse(response.second);
+          std::move(chunk.begin(), chunk.end(), values.begin() + c.begin);
+      });
+      return values;
+  }
+
+  /**
+   * @brief Runs the operation in the calling ULT if req is null,
+   * otherwise pushes it to the work queue and sets req to track it.
+   */
+  template<typename Function>
+  void submit(Function&& operation, AsyncRequest *req) const {
+      if(!req) {
+          operation();
+          return;
+      }
+      auto op = std::make_shared<OperationAsyncRequest>(std::forward<Function>(operation));
+      m_queue->push(op);
+      *req = AsyncRequest{std::move(op)};
+  }
 
 public:
 
-  template<typename ... Args>
-  YokanCollection(const tl::engine& engine, Args&&... args)
+  YokanCollection(const tl::engine& engine,
+                  std::shared_ptr<YokanWorkQueue> queue,
+                  DocumentFormat format,
+                  std::shared_ptr<const DocumentCompressor> compressor,
+                  std::shared_ptr<const YokanPatchRPC> patch,
+                  const std::string& name,
+                  const yokan::Database& db)
   : m_engine(engine)
-  , m_coll(std::forward<Args>(args)...) {}
+  , m_queue(std::move(queue))
+  , m_format(format)
+  , m_compressor(std::move(compressor))
+  , m_patch(std::move(patch))
+  , m_name(name)
+  , m_coll(m_name.c_str(), db) {}
 
   ~YokanCollection() = default;
 
@@ -33,269 +654,271 @@ public:
 
   uint64_t store(const std::string &record, bool commit) const override {
       (void)commit;
-      return m_coll.store(record.data(), record.size());
+      std::string buf;
+      auto doc = toStored(record, buf);
+      return m_coll.store(doc.data(), doc.size());
   }
 
   uint64_t store(const json &record, bool commit) const override {
-      return store(record.dump(), commit);
+      (void)commit;
+      std::string doc;
+      encodeDoc(record, doc);
+      return m_coll.store(doc.data(), doc.size());
   }
 
   uint64_t store(const char *record, bool commit) const override {
       (void)commit;
-      return m_coll.store(record, strlen(record));
+      std::string buf;
+      auto doc = toStored(record, buf);
+      return m_coll.store(doc.data(), doc.size());
   }
 
   void store(const std::string &record, uint64_t *id, bool commit,
              AsyncRequest *req) const override {
       auto thread = [&record, id, this]() {
-        auto i = m_coll.store(record.data(), record.size());
+        std::string buf;
+        auto doc = toStored(record, buf);
+        auto i = m_coll.store(doc.data(), doc.size());
         if(id) *id = i;
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void store(const json &record, uint64_t *id, bool commit,
              AsyncRequest *req) const override {
       auto thread = [&record, id, this]() {
-        auto record_str = record.dump();
-        auto i = m_coll.store(record_str.data(), record_str.size());
+        std::string doc;
+        encodeDoc(record, doc);
+        auto i = m_coll.store(doc.data(), doc.size());
         if(id) *id = i;
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void store(const char *record, uint64_t *id, bool commit,
              AsyncRequest *req) const override {
       auto thread = [record, id, this]() {
-        auto i = m_coll.store(record, strlen(record));
+        std::string buf;
+        auto doc = toStored(record, buf);
+        auto i = m_coll.store(doc.data(), doc.size());
         if(id) *id = i;
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void store_multi(const std::vector<std::string> &records, uint64_t *ids,
                    bool commit, AsyncRequest *req) const override {
       auto thread = [&records, ids, this]() {
         const auto n = records.size();
+        std::vector<std::string> encoded;
         std::vector<const void*> documents;
         std::vector<size_t>      docsizes;
-        documents.reserve(n);
-        docsizes.reserve(n);
-        for(const auto& r : records) {
-            documents.push_back(r.data());
-            docsizes.push_back(r.size());
-        }
-        m_coll.storeMulti(n, documents.data(), docsizes.data(), ids);
+        toStored(n, [&records](size_t i) { return std::string_view{records[i]}; },
+                 encoded, documents, docsizes);
+        storeDocs(n, documents.data(), docsizes.data(), ids);
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void store_multi(const json &records, uint64_t *ids,
                    bool commit, AsyncRequest *req) const override {
       auto thread = [&records, ids, this]() {
         const auto n = records.size();
-        std::vector<std::string> docs;
-        std::vector<const void*> documents;
-        std::vector<size_t>      docsizes;
-        docs.resize(n);
-        documents.reserve(n);
-        docsizes.reserve(n);
-        for(const auto& r : records) {
-            docs.push_back(r.dump());
-        }
-        for(const auto& r : docs) {
-            documents.push_back(r.data());
-            docsizes.push_back(r.size());
-        }
-        m_coll.storeMulti(n, documents.data(), docsizes.data(), ids);
+        std::vector<std::string> docs(n);
+        std::vector<const void*> documents(n);
+        std::vector<size_t>      docsizes(n);
+        m_queue->parallel_for(n, [&](size_t i) {
+            encodeDoc(records[i], docs[i]);
+            documents[i] = docs[i].data();
+            docsizes[i]  = docs[i].size();
+        });
+        storeDocs(n, documents.data(), docsizes.data(), ids);
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void store_multi(const char *const *records, size_t count, uint64_t *ids,
                    bool commit, AsyncRequest *req) const override {
       auto thread = [records, count, ids, this]() {
-        std::vector<size_t> docsizes;
-        docsizes.reserve(count);
-        for(unsigned i = 0; i < count; ++i) {
-            docsizes.push_back(strlen(records[i]));
+        std::vector<std::string> encoded;
+        std::vector<const void*> documents;
+        std::vector<size_t>      docsizes;
+        toStored(count, [records](size_t i) { return std::string_view{records[i]}; },
+                 encoded, documents, docsizes);
+        storeDocs(count, documents.data(), docsizes.data(), ids);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void store_multi(const char *data, const size_t *sizes, size_t count,
+                   uint64_t *ids, bool commit, AsyncRequest *req) const override {
+      (void)commit;
+      auto thread = [data, sizes, count, ids, this]() {
+        if(storesText()) {
+            storePackedDocs(count, data, sizes, ids);
+            return;
         }
-        m_coll.storeMulti(count, (const void* const*)records, docsizes.data(), ids);
+        auto offsets = packedOffsets(sizes, count);
+        std::vector<std::string> encoded;
+        std::vector<const void*> documents;
+        std::vector<size_t>      docsizes;
+        toStored(count, [&](size_t i) { return std::string_view{data + offsets[i], sizes[i]}; },
+                 encoded, documents, docsizes);
+        storeDocs(count, documents.data(), docsizes.data(), ids);
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
+  }
+
+  void store_multi(const std::string_view *records, size_t count,
+                   uint64_t *ids, bool commit, AsyncRequest *req) const override {
+      (void)commit;
+      auto thread = [records, count, ids, this]() {
+        std::vector<std::string> encoded;
+        std::vector<const void*> documents;
+        std::vector<size_t>      docsizes;
+        toStored(count, [records](size_t i) { return records[i]; },
+                 encoded, documents, docsizes);
+        storeDocs(count, documents.data(), docsizes.data(), ids);
+      };
+      submit(std::move(thread), req);
   }
 
   void fetch(uint64_t id, std::string *result,
              AsyncRequest *req) const override {
       auto thread = [id, result, this]() {
-        size_t size = m_coll.length(id);
-        std::string buffer(size, '\0');
-        m_coll.load(id, (void*)buffer.data(), &size);
-        buffer.resize(size);
-        if(result) *result = std::move(buffer);
-      };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+        DocumentBatch batch;
+        loadDocs(&id, 1, batch, false);
+        if(result) *result = toText(batch[0]);
+      };
+      submit(std::move(thread), req);
   }
 
   void fetch(uint64_t id, json *result,
              AsyncRequest *req) const override {
       auto thread = [id, result, this]() {
-        size_t size = m_coll.length(id);
-        std::string buffer(size, '\0');
-        m_coll.load(id, (void*)buffer.data(), &size);
-        buffer.resize(size);
-        if(result) *result = json::parse(buffer);
-      };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+        DocumentBatch batch;
+        loadDocs(&id, 1, batch, false);
+        if(result) *result = decodeDoc(batch[0]);
+      };
+      submit(std::move(thread), req);
   }
 
   void fetch_multi(const uint64_t *ids, size_t count,
                    std::vector<std::string> *result,
                    AsyncRequest *req) const override {
       auto thread = [ids, count, result, this]() {
-        std::vector<size_t> sizes(count);
-        m_coll.lengthMulti(count, ids, sizes.data());
-        std::vector<std::string> buffers(count);
-        std::vector<const void*> documents(count);
-        for(unsigned i = 0; i < count; ++i) {
-            buffers[i].resize(sizes[i]);
-            documents[i] = buffers[i].data();
-        }
-        m_coll.loadMulti(count, ids, (void *const *)documents.data(), sizes.data());
+        DocumentBatch batch;
+        loadChunked(ids, count, batch, false);
         if(!result) return;
-        for(unsigned i = 0; i < count; ++i) {
-            buffers[i].resize(sizes[i]);
-        }
-        *result = std::move(buffers);
+        result->clear();
+        result->reserve(batch.size());
+        toText(batch, *result);
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void fetch_multi(const uint64_t *ids, size_t count, json *result,
                    AsyncRequest *req) const override {
       auto thread = [ids, count, result, this]() {
-        std::vector<size_t> sizes(count);
-        m_coll.lengthMulti(count, ids, sizes.data());
-        std::vector<std::string> buffers(count);
-        std::vector<const void*> documents(count);
-        for(unsigned i = 0; i < count; ++i) {
-            buffers[i].resize(sizes[i]);
-            documents[i] = buffers[i].data();
-        }
-        m_coll.loadMulti(count, ids, (void *const *)documents.data(), sizes.data());
+        DocumentBatch batch;
+        loadChunked(ids, count, batch, false);
         if(!result) return;
-        *result = json::array();
-        for(unsigned i = 0; i < count; ++i) {
-            buffers[i].resize(sizes[i]);
-            result->push_back(json::parse(buffers[i]));
+        json::array_t docs(batch.size());
+        m_queue->parallel_for(batch.size(), [&](size_t i) {
+            docs[i] = decodeDoc(batch[i]);
+        });
+        *result = std::move(docs);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void fetch_multi(const uint64_t *ids, size_t count, DocumentBatch *result,
+                   AsyncRequest *req) const override {
+      auto thread = [ids, count, result, this]() {
+        if(!result) {
+            DocumentBatch batch;
+            loadChunked(ids, count, batch, true);
+            return;
         }
+        result->clear();
+        loadChunked(ids, count, *result, true);
+        toText(*result);
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
+  }
+
+  void filter(const std::string &filterCode, DocumentBatch *result,
+              AsyncRequest *req) const override {
+      auto thread = [filterCode, result, this]() {
+        DocumentBatch batch;
+        auto& out = result ? *result : batch;
+        out.clear();
+        listDocs(filterCode, s_page_count, out, [](DocumentBatch&, size_t) {});
+        toText(out);
+      };
+      submit(std::move(thread), req);
   }
 
   void filter(const std::string &filterCode, std::vector<std::string> *result,
               AsyncRequest *req) const override {
-      // TODO
-      throw Exception{std::string{"Function "} + __PRETTY_FUNCTION__ + " is not implemented"};
+      auto thread = [filterCode, result, this]() {
+        std::vector<std::string> docs;
+        DocumentBatch batch;
+        listDocs(filterCode, s_page_count, batch, [&docs, this](DocumentBatch& page, size_t) {
+            toText(page, docs);
+            page.clear();
+        });
+        if(result) *result = std::move(docs);
+      };
+      submit(std::move(thread), req);
   }
 
   void filter(const std::string &filterCode, json *result,
               AsyncRequest *req) const override {
-      // TODO
-      throw Exception{std::string{"Function "} + __PRETTY_FUNCTION__ + " is not implemented"};
+      auto thread = [filterCode, result, this]() {
+        auto docs = json::array();
+        DocumentBatch batch;
+        listDocs(filterCode, s_page_count, batch, [&docs, this](DocumentBatch& page, size_t) {
+            for(size_t i = 0; i < page.size(); ++i)
+                docs.push_back(decodeDoc(page[i]));
+            page.clear();
+        });
+        if(result) *result = std::move(docs);
+      };
+      submit(std::move(thread), req);
   }
 
   void update(uint64_t id, const std::string &record, bool commit,
               AsyncRequest *req) const override {
       (void)commit;
       auto thread = [id, &record, this]() {
-          m_coll.update(id, (void*)record.data(), record.size());
+          std::string buf;
+          auto doc = toStored(record, buf);
+          m_coll.update(id, doc.data(), doc.size());
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void update(uint64_t id, const json &record, bool commit,
               AsyncRequest *req) const override {
       (void)commit;
       auto thread = [id, &record, this]() {
-          auto record_str = record.dump();
-          m_coll.update(id, (void*)record_str.data(), record_str.size());
-      };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+          std::string doc;
+          encodeDoc(record, doc);
+          m_coll.update(id, doc.data(), doc.size());
+      };
+      submit(std::move(thread), req);
   }
 
   void update(uint64_t id, const char *record, bool commit,
               AsyncRequest *req) const override {
       (void)commit;
       auto thread = [id, record, this]() {
-          m_coll.update(id, (void*)record, strlen(record));
+          std::string buf;
+          auto doc = toStored(record, buf);
+          m_coll.update(id, doc.data(), doc.size());
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void update_multi(const uint64_t *ids, const json &records,
@@ -307,11 +930,11 @@ public:
           std::vector<std::string> docs(n);
           std::vector<const void*> docsPtr(n);
           std::vector<size_t> docSizes(n);
-          for(unsigned i = 0; i < n; ++i) {
-            docs[i] = records[i].dump();
+          m_queue->parallel_for(n, [&](size_t i) {
+            encodeDoc(records[i], docs[i]);
             docsPtr[i] = docs[i].data();
             docSizes[i] = docs[i].size();
-          }
+          });
           m_coll.updateMulti(n, ids, (const void *const*)docsPtr.data(), docSizes.data());
           if(!updated) return;
           updated->resize(n);
@@ -319,12 +942,7 @@ public:
               (*updated)[i] = true;
           }
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void update_multi(const uint64_t *ids,
@@ -334,12 +952,11 @@ public:
       (void)commit;
       auto thread = [ids, &records, updated, this]() {
           auto n = records.size();
-          std::vector<const void*> docsPtr(n);
-          std::vector<size_t> docSizes(n);
-          for(unsigned i = 0; i < n; ++i) {
-            docsPtr[i] = records[i].data();
-            docSizes[i] = records[i].size();
-          }
+          std::vector<std::string> encoded;
+          std::vector<const void*> docsPtr;
+          std::vector<size_t> docSizes;
+          toStored(n, [&records](size_t i) { return std::string_view{records[i]}; },
+                   encoded, docsPtr, docSizes);
           m_coll.updateMulti(n, ids, (const void *const*)docsPtr.data(), docSizes.data());
           if(!updated) return;
           updated->resize(n);
@@ -347,12 +964,7 @@ public:
               (*updated)[i] = true;
           }
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void update_multi(uint64_t *ids, const char *const *records, size_t count,
@@ -361,12 +973,11 @@ public:
       (void)commit;
       auto thread = [ids, records, count, updated, this]() {
           auto n = count;
-          std::vector<const void*> docsPtr(n);
-          std::vector<size_t> docSizes(n);
-          for(unsigned i = 0; i < n; ++i) {
-            docsPtr[i] = records[i];
-            docSizes[i] = strlen(records[i]);
-          }
+          std::vector<std::string> encoded;
+          std::vector<const void*> docsPtr;
+          std::vector<size_t> docSizes;
+          toStored(n, [records](size_t i) { return std::string_view{records[i]}; },
+                   encoded, docsPtr, docSizes);
           m_coll.updateMulti(n, ids, (const void *const*)docsPtr.data(), docSizes.data());
           if(!updated) return;
           updated->resize(n);
@@ -374,22 +985,227 @@ public:
               (*updated)[i] = true;
           }
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
+  }
+
+  void update_multi(const uint64_t *ids, const char *data,
+                    const size_t *sizes, size_t count,
+                    std::vector<bool> *updated, bool commit,
+                    AsyncRequest *req) const override {
+      (void)commit;
+      auto thread = [ids, data, sizes, count, updated, this]() {
+          if(storesText()) {
+              m_coll.updatePacked(count, ids, data, sizes);
+          } else {
+              auto offsets = packedOffsets(sizes, count);
+              std::vector<std::string> encoded;
+              std::vector<const void*> docsPtr;
+              std::vector<size_t> docSizes;
+              toStored(count, [&](size_t i) { return std::string_view{data + offsets[i], sizes[i]}; },
+                       encoded, docsPtr, docSizes);
+              m_coll.updateMulti(count, ids, docsPtr.data(), docSizes.data());
+          }
+          if(!updated) return;
+          updated->assign(count, true);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void update_multi(const uint64_t *ids, const std::string_view *records,
+                    size_t count, std::vector<bool> *updated, bool commit,
+                    AsyncRequest *req) const override {
+      (void)commit;
+      auto thread = [ids, records, count, updated, this]() {
+          std::vector<std::string> encoded;
+          std::vector<const void*> docsPtr;
+          std::vector<size_t> docSizes;
+          toStored(count, [records](size_t i) { return records[i]; },
+                   encoded, docsPtr, docSizes);
+          m_coll.updateMulti(count, ids, docsPtr.data(), docSizes.data());
+          if(!updated) return;
+          updated->assign(count, true);
+      };
+      submit(std::move(thread), req);
   }
 
   void all(std::vector<std::string> *result, AsyncRequest *req) const override {
-      // TODO
-      throw Exception{std::string{"Function "} + __PRETTY_FUNCTION__ + " is not implemented"};
+      filter(std::string{}, result, req);
   }
 
   void all(json *result, AsyncRequest *req) const override {
-      // TODO
-      throw Exception{std::string{"Function "} + __PRETTY_FUNCTION__ + " is not implemented"};
+      filter(std::string{}, result, req);
+  }
+
+  void all(DocumentBatch *result, AsyncRequest *req) const override {
+      filter(std::string{}, result, req);
+  }
+
+  void all(const std::function<void(const std::vector<std::string>&)> &callback,
+           size_t batch_size, AsyncRequest *req) const override {
+      auto thread = [callback, batch_size, this]() {
+        std::vector<std::string> docs;
+        DocumentBatch batch;
+        listDocs(std::string{}, batch_size, batch, [&callback, &docs, this](DocumentBatch& page, size_t) {
+            docs.clear();
+            toText(page, docs);
+            page.clear();
+            callback(docs);
+        });
+      };
+      submit(std::move(thread), req);
+  }
+
+  /**
+   * The *_async overrides move the payload into the operation itself
+   * and capture the AsyncResult, so the operation owns everything it
+   * touches even if the caller drops the AsyncResult before it runs.
+   */
+  AsyncResult<uint64_t> store_async(std::string &&record,
+                                    bool commit) const override {
+      (void)commit;
+      AsyncResult<uint64_t> result;
+      auto thread = [record = std::move(record), result, this]() {
+          std::string buf;
+          auto doc = toStored(record, buf);
+          *result.value_ptr() = m_coll.store(doc.data(), doc.size());
+      };
+      submit(std::move(thread), result.request_ptr());
+      return result;
+  }
+
+  AsyncResult<uint64_t> store_async(json &&record,
+                                    bool commit) const override {
+      (void)commit;
+      AsyncResult<uint64_t> result;
+      auto thread = [record = std::move(record), result, this]() {
+          std::string doc;
+          encodeDoc(record, doc);
+          *result.value_ptr() = m_coll.store(doc.data(), doc.size());
+      };
+      submit(std::move(thread), result.request_ptr());
+      return result;
+  }
+
+  AsyncResult<std::vector<uint64_t>> store_multi_async(
+        std::vector<std::string> &&records, bool commit) const override {
+      (void)commit;
+      AsyncResult<std::vector<uint64_t>> result;
+      auto thread = [records = std::move(records), result, this]() {
+          const auto n = records.size();
+          std::vector<std::string> encoded;
+          std::vector<const void*> documents;
+          std::vector<size_t>      docsizes;
+          toStored(n, [&records](size_t i) { return std::string_view{records[i]}; },
+                   encoded, documents, docsizes);
+          auto ids = result.value_ptr();
+          ids->resize(n);
+          storeDocs(n, documents.data(), docsizes.data(), ids->data());
+      };
+      submit(std::move(thread), result.request_ptr());
+      return result;
+  }
+
+  AsyncResult<std::string> fetch_async(uint64_t id) const override {
+      AsyncResult<std::string> result;
+      auto thread = [id, result, this]() {
+          DocumentBatch batch;
+          loadDocs(&id, 1, batch, false);
+          *result.value_ptr() = toText(batch[0]);
+      };
+      submit(std::move(thread), result.request_ptr());
+      return result;
+  }
+
+  AsyncResult<json> fetch_json_async(uint64_t id) const override {
+      AsyncResult<json> result;
+      auto thread = [id, result, this]() {
+          DocumentBatch batch;
+          loadDocs(&id, 1, batch, false);
+          *result.value_ptr() = decodeDoc(batch[0]);
+      };
+      submit(std::move(thread), result.request_ptr());
+      return result;
+  }
+
+  AsyncResult<void> update_async(uint64_t id, std::string &&record,
+                                 bool commit) const override {
+      (void)commit;
+      AsyncResult<void> result;
+      auto thread = [id, record = std::move(record), this]() {
+          std::string buf;
+          auto doc = toStored(record, buf);
+          m_coll.update(id, doc.data(), doc.size());
+      };
+      submit(std::move(thread), result.request_ptr());
+      return result;
+  }
+
+  AsyncResult<void> update_async(uint64_t id, json &&record,
+                                 bool commit) const override {
+      (void)commit;
+      AsyncResult<void> result;
+      auto thread = [id, record = std::move(record), this]() {
+          std::string doc;
+          encodeDoc(record, doc);
+          m_coll.update(id, doc.data(), doc.size());
+      };
+      submit(std::move(thread), result.request_ptr());
+      return result;
+  }
+
+  void fetch_range(uint64_t first, size_t count, DocumentBatch *result,
+                   AsyncRequest *req) const override {
+      auto thread = [first, count, result, this]() {
+        DocumentBatch batch;
+        auto& out = result ? *result : batch;
+        out.clear();
+        listDocs("", s_page_count, out, [](DocumentBatch&, size_t) {},
+                 first, rangeEnd(first, count));
+        toText(out);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void fetch_range(uint64_t first, size_t count, std::vector<std::string> *result,
+                   AsyncRequest *req) const override {
+      auto thread = [first, count, result, this]() {
+        std::vector<std::string> docs;
+        DocumentBatch batch;
+        listDocs("", s_page_count, batch, [&docs, this](DocumentBatch& page, size_t) {
+            toText(page, docs);
+            page.clear();
+        }, first, rangeEnd(first, count));
+        if(result) *result = std::move(docs);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void erase_range(uint64_t first, size_t count, bool commit,
+                   AsyncRequest *req) const override {
+      (void)commit;
+      // Yokan has no range erasure, so the existing records of the
+      // range are listed a page at a time, with their documents
+      // reduced to empty projections by the provider, and erased.
+      auto thread = [first, count, this]() {
+        const auto end = rangeEnd(first, count);
+        DocumentBatch batch;
+        std::vector<yk_id_t> ids;
+        auto erase = [&ids, this](DocumentBatch& page, size_t) {
+            ids.clear();
+            for(size_t i = 0; i < page.size(); ++i) ids.push_back(page.id(i));
+            page.clear();
+            if(!ids.empty()) m_coll.eraseMulti(ids.size(), ids.data());
+        };
+        project([&]() {
+            listDocs(projectionFilter(Projection{std::vector<std::string>{}}, json::array(),
+                                      std::numeric_limits<uint64_t>::max()),
+                     s_erase_chunk, batch, erase, first, end, YOKAN_MODE_LIB_FILTER);
+        }, [&]() {
+            batch.clear();
+            listDocs("", s_erase_chunk, batch, erase, first, end);
+        });
+      };
+      submit(std::move(thread), req);
   }
 
   uint64_t last_record_id() const override {
@@ -400,18 +1216,125 @@ public:
       return m_coll.size();
   }
 
+  void fetch(uint64_t id, const std::vector<std::string> &fields,
+             json *result, AsyncRequest *req) const override {
+      auto thread = [id, fields, result, this]() {
+        json docs;
+        fetch_multi(&id, 1, fields, &docs, nullptr);
+        if(result) *result = std::move(docs[0]);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void fetch_multi(const uint64_t *ids, size_t count,
+                   const std::vector<std::string> &fields,
+                   json *result, AsyncRequest *req) const override {
+      Projection projection{fields};
+      auto thread = [ids, count, projection = std::move(projection), result, this]() {
+        json::array_t docs(count);
+        project([&]() {
+            auto projected = listProjected({ids, ids + count}, projection);
+            for(size_t i = 0; i < count; ++i) {
+                auto it = std::lower_bound(projected.begin(), projected.end(), ids[i],
+                    [](const auto& p, uint64_t id) { return p.first < id; });
+                if(it == projected.end() || it->first != ids[i])
+                    throw Exception{"Record " + std::to_string(ids[i]) + " does not exist"};
+                docs[i] = it->second;
+            }
+        }, [&]() {
+            DocumentBatch batch;
+            loadChunked(ids, count, batch, false);
+            m_queue->parallel_for(batch.size(), [&](size_t i) {
+                docs[i] = projection.apply(decodeDoc(batch[i]));
+            });
+        });
+        if(result) *result = std::move(docs);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void filter(const std::string &filterCode, const std::vector<std::string> &fields,
+              json *result, AsyncRequest *req) const override {
+      Projection projection{fields};
+      auto thread = [filterCode, projection = std::move(projection), result, this]() {
+        auto docs = json::array();
+        // Yokan runs one filter per request, so the documents matching
+        // a Lua filter are reduced here
+        auto on_client = [&]() {
+            DocumentBatch batch;
+            docs = json::array();
+            listDocs(filterCode, s_page_count, batch,
+                     [&docs, &projection, this](DocumentBatch& page, size_t) {
+                for(size_t i = 0; i < page.size(); ++i)
+                    docs.push_back(projection.apply(decodeDoc(page[i])));
+                page.clear();
+            });
+        };
+        if(!filterCode.empty()) {
+            on_client();
+        } else {
+            project([&]() {
+                DocumentBatch batch;
+                listDocs(projectionFilter(projection, json::array(),
+                                          std::numeric_limits<uint64_t>::max()),
+                         s_page_count, batch, [&docs, this](DocumentBatch& page, size_t) {
+                    for(size_t i = 0; i < page.size(); ++i)
+                        docs.push_back(decode(m_format, page[i]));
+                    page.clear();
+                }, 0, std::numeric_limits<yk_id_t>::max(), YOKAN_MODE_LIB_FILTER);
+            }, on_client);
+        }
+        if(result) *result = std::move(docs);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void patch(uint64_t id, const json &patch, bool commit,
+             AsyncRequest *req) const override {
+      (void)commit;
+      auto thread = [id, patch, this]() {
+        patchDocs(&id, 1, patch);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void patch_multi(const uint64_t *ids, size_t count, const json &patch,
+                   bool commit, AsyncRequest *req) const override {
+      (void)commit;
+      auto thread = [ids, count, patch, this]() {
+        patchDocs(ids, count, patch);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void increment(uint64_t id, const std::string &field, const json &delta,
+                 json *result, bool commit, AsyncRequest *req) const override {
+      (void)commit;
+      auto thread = [id, field, delta, result, this]() {
+        auto values = incrementDocs(&id, 1, field, delta);
+        if(result) *result = std::move(values[0]);
+      };
+      submit(std::move(thread), req);
+  }
+
+  void increment_multi(const uint64_t *ids, size_t count,
+                       const std::string &field, const json &delta,
+                       json *result, bool commit, AsyncRequest *req) const override {
+      (void)commit;
+      auto thread = [ids, count, field, delta, result, this]() {
+        auto values = incrementDocs(ids, count, field, delta);
+        if(result) *result = std::move(values);
+      };
+      submit(std::move(thread), req);
+  }
+
   void erase(uint64_t id, bool commit,
              AsyncRequest *req) const override {
       (void)commit;
       auto thread = [id, this]() {
         m_coll.erase(id);
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 
   void erase_multi(const uint64_t *ids, size_t size, bool commit,
@@ -420,12 +1343,7 @@ public:
       auto thread = [ids, size, this]() {
         m_coll.eraseMulti(size, ids);
       };
-      if(!req) thread();
-      else {
-        auto ult = m_engine.get_progress_pool().make_thread(std::move(thread));
-        tl::thread::yield_to(*ult);
-        *req = AsyncRequest{std::make_shared<YokanAsyncRequest>(std::move(ult))};
-      }
+      submit(std::move(thread), req);
   }
 };
 
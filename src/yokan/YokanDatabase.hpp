@@ -5,6 +5,7 @@
  */
 #include "YokanCollection.hpp"
 #include <isonata/Database.hpp>
+#include <isonata/DocumentFormat.hpp>
 #include <isonata/Exception.hpp>
 #include <yokan/cxx/database.hpp>
 #include <yokan/cxx/collection.hpp>
@@ -16,21 +17,100 @@ using nlohmann::json;
 
 class YokanDatabase : public AbstractDatabaseImpl {
 
-  tl::engine      m_engine;
-  yokan::Database m_db;
+  tl::engine                           m_engine;
+  std::shared_ptr<YokanWorkQueue>      m_queue;
+  yokan::Database                      m_db;
+  std::shared_ptr<const YokanPatchRPC> m_patch;
+
+  /**
+   * @brief Keys under which the storage options of a collection that
+   * does not store uncompressed JSON text, and its compression
+   * dictionary if it has one, are recorded in the database.
+   */
+  static std::string storageKey(const std::string &collectionName) {
+      return "isonata/storage/" + collectionName;
+  }
+
+  static std::string dictionaryKey(const std::string &collectionName) {
+      return "isonata/dictionary/" + collectionName;
+  }
+
+  std::string getValue(const std::string &key) const {
+      std::string value(m_db.length(key.data(), key.size()), '\0');
+      size_t size = value.size();
+      m_db.get(key.data(), key.size(), value.data(), &size);
+      value.resize(size);
+      return value;
+  }
+
+  void eraseValue(const std::string &key) const {
+      if(m_db.exists(key.data(), key.size()))
+          m_db.erase(key.data(), key.size());
+  }
+
+  Collection makeCollection(const std::string &collectionName, DocumentFormat format,
+                            const json &compression, std::string_view dictionary) const {
+      std::shared_ptr<const DocumentCompressor> compressor;
+      if(!compression.is_null())
+          compressor = DocumentCompressor::create(compression, dictionary);
+      auto coll = std::make_shared<YokanCollection>(
+          m_engine, m_queue, format, std::move(compressor), m_patch, collectionName, m_db);
+      return Collection{coll};
+  }
 
 public:
 
-  YokanDatabase(const tl::engine& engine, yokan::Database db)
+  YokanDatabase(const tl::engine& engine,
+                std::shared_ptr<YokanWorkQueue> queue,
+                yokan::Database db,
+                const tl::provider_handle& provider,
+                const std::string& db_name)
   : m_engine(engine)
-  , m_db(std::move(db)) {}
+  , m_queue(std::move(queue))
+  , m_db(std::move(db))
+  , m_patch(std::make_shared<const YokanPatchRPC>(YokanPatchRPC{
+        m_engine.define("isonata_yokan_patch"),
+        m_engine.define("isonata_yokan_increment"),
+        m_engine.define("isonata_yokan_swap"),
+        provider, db_name})) {}
 
   ~YokanDatabase() {}
 
   Collection create(const std::string &collectionName) const override {
+      return create(collectionName, json::object());
+  }
+
+  Collection create(const std::string &collectionName, const json &options) const override {
+      auto format = format_option(options);
+      json compression;
+      std::string dictionary;
+      if(options.is_object() && options.contains("compression")) {
+          compression = options["compression"];
+          if(compression.is_object() && compression.contains("dictionary_samples")) {
+              const auto& samples = compression["dictionary_samples"];
+              if(!samples.is_array())
+                  throw Exception{"\"compression.dictionary_samples\" should be an array"};
+              std::vector<std::string> encoded(samples.size());
+              for(size_t i = 0; i < samples.size(); ++i)
+                  encode(format, samples[i], encoded[i]);
+              dictionary = DocumentCompressor::train(compression, encoded);
+              compression.erase("dictionary_samples");
+          }
+      }
+      auto coll = makeCollection(collectionName, format, compression, dictionary);
       m_db.createCollection(collectionName.c_str());
-      auto coll = std::make_shared<YokanCollection>(m_engine, collectionName.c_str(), m_db);
-      return Collection{coll};
+      if(format != DocumentFormat::JSON || !compression.is_null()) {
+          auto key = storageKey(collectionName);
+          auto storage = json{{"format", format_name(format)},
+                              {"compression", compression},
+                              {"dictionary", !dictionary.empty()}}.dump();
+          m_db.put(key.data(), key.size(), storage.data(), storage.size());
+      }
+      if(!dictionary.empty()) {
+          auto key = dictionaryKey(collectionName);
+          m_db.put(key.data(), key.size(), dictionary.data(), dictionary.size());
+      }
+      return coll;
   }
 
   bool exists(const std::string &collectionName) const override {
@@ -40,12 +120,21 @@ public:
   Collection open(const std::string &collectionName, bool check) const override {
       if(!exists(collectionName))
           throw Exception(std::string{"Collection "} + collectionName + " does not exist");
-      auto coll = std::make_shared<YokanCollection>(m_engine, collectionName.c_str(), m_db);
-      return Collection{coll};
+      auto key = storageKey(collectionName);
+      if(!m_db.exists(key.data(), key.size()))
+          return makeCollection(collectionName, DocumentFormat::JSON, json{}, {});
+      auto storage = json::parse(getValue(key));
+      std::string dictionary;
+      if(storage["dictionary"].get<bool>())
+          dictionary = getValue(dictionaryKey(collectionName));
+      return makeCollection(collectionName, format_option(storage),
+                            storage["compression"], dictionary);
   }
 
   void drop(const std::string &collectionName) const override {
       m_db.dropCollection(collectionName.c_str());
+      eraseValue(storageKey(collectionName));
+      eraseValue(dictionaryKey(collectionName));
   }
 
   void execute(
@@ -0,0 +1,107 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_YOKAN_FILTERS_HPP
+#define __ISONATA_YOKAN_FILTERS_HPP
+
+#include "ProviderFormat.hpp"
+#include "../Projection.hpp"
+#include <yokan/filters.hpp>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_set>
+
+namespace isonata {
+
+/**
+ * @brief Yokan document filter that reduces documents to a set of
+ * fields on the provider. Its argument is a JSON object with the
+ * "fields" to keep (see Projection), the "format" in which the
+ * documents are stored, and optionally the "ids" of the records to
+ * select and the "last" id to select, all the records being selected
+ * otherwise. Projected documents are stored in the same format.
+ *
+ * It is registered as "isonata_projection" when the provider process
+ * loads ISonata's server library, so clients select it with the
+ * filter string ":isonata_projection:<argument>" (no library to load)
+ * and YOKAN_MODE_LIB_FILTER.
+ */
+class YokanProjectionFilter : public yokan::DocFilter {
+
+  Projection                  m_projection;
+  DocumentFormat              m_format = DocumentFormat::JSON;
+  std::unordered_set<yk_id_t> m_ids;
+  bool                        m_all = true;
+  yk_id_t                     m_last_id = std::numeric_limits<yk_id_t>::max();
+  mutable std::string         m_last;
+  mutable std::string         m_projected;
+
+  static Projection parseFields(const json& args) {
+      if(!args.is_object() || !args.contains("fields") || !args["fields"].is_array())
+          throw Exception{"Projection filter arguments should have a \"fields\" array"};
+      return Projection{args["fields"].get<std::vector<std::string>>()};
+  }
+
+  /**
+   * @brief Projects the document, reusing the previous projection if
+   * the document is the same, since Yokan calls docSizeFrom and then
+   * docCopy on each document.
+   */
+  const std::string& project(const void* doc, size_t size) const {
+      if(m_last.size() == size && std::memcmp(m_last.data(), doc, size) == 0)
+          return m_projected;
+      m_last.assign(static_cast<const char*>(doc), size);
+      dumpStored(m_format, m_projection.apply(parseStored(m_format, m_last)), m_projected);
+      return m_projected;
+  }
+
+public:
+
+  YokanProjectionFilter(margo_instance_id mid, int32_t mode, const yokan::UserMem& args)
+  : YokanProjectionFilter(json::parse(args.data, args.data + args.size)) {
+      (void)mid;
+      (void)mode;
+  }
+
+  YokanProjectionFilter(const json& args)
+  : m_projection(parseFields(args)) {
+      if(args.contains("format"))
+          m_format = parse_format(args["format"].get<std::string>());
+      if(args.contains("ids")) {
+          m_all = false;
+          for(const auto& id : args["ids"]) m_ids.insert(id.get<yk_id_t>());
+      }
+      if(args.contains("last"))
+          m_last_id = args["last"].get<yk_id_t>();
+  }
+
+  bool check(const char* collection, yk_id_t id, const void* doc, size_t docsize) const override {
+      (void)collection;
+      (void)doc;
+      (void)docsize;
+      return id <= m_last_id && (m_all || m_ids.count(id));
+  }
+
+  size_t docSizeFrom(const char* collection, const void* val, size_t vsize) const override {
+      (void)collection;
+      return project(val, vsize).size();
+  }
+
+  size_t docCopy(const char* collection, void* dst, size_t max_dst_size,
+                 const void* val, size_t vsize) const override {
+      (void)collection;
+      const auto& projected = project(val, vsize);
+      if(projected.size() > max_dst_size) return YOKAN_SIZE_TOO_SMALL;
+      std::memcpy(dst, projected.data(), projected.size());
+      return projected.size();
+  }
+};
+
+} // namespace isonata
+
+YOKAN_REGISTER_DOC_FILTER(isonata_projection, isonata::YokanProjectionFilter);
+
+#endif
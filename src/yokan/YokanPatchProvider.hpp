@@ -0,0 +1,209 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_YOKAN_PATCH_PROVIDER_HPP
+#define __ISONATA_YOKAN_PATCH_PROVIDER_HPP
+
+#include <isonata/Exception.hpp>
+#include "ProviderFormat.hpp"
+#include "../Patch.hpp"
+#include <yokan/cxx/client.hpp>
+#include <yokan/cxx/collection.hpp>
+#include <thallium.hpp>
+#include <thallium/serialization/stl/pair.hpp>
+#include <thallium/serialization/stl/string.hpp>
+#include <thallium/serialization/stl/vector.hpp>
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief Thallium provider registered next to the Yokan provider,
+ * with the same provider id, to modify documents where they are
+ * stored: Yokan only updates whole documents, so its RPCs load the
+ * documents from the local Yokan provider, modify them, and update
+ * them. The patch RPC responds with an error message, empty on
+ * success; the increment RPC with an error message and the new
+ * values as a JSON array. The swap RPC lets clients modify documents
+ * that the provider cannot decode (compressed documents).
+ *
+ * The documents are modified while holding locks striped by record
+ * id, so that concurrent patches, increments and swaps of a record do
+ * not interleave. Updates sent directly to Yokan do not take these locks.
+ */
+class YokanPatchProvider : public tl::provider<YokanPatchProvider> {
+
+  static constexpr size_t s_lock_stripes = 64;
+
+  yokan::Client                         m_client;
+  tl::endpoint                          m_self;
+  uint16_t                              m_provider_id;
+  std::array<tl::mutex, s_lock_stripes> m_locks;
+
+  /**
+   * @brief Locks the stripes of the ids, in order to avoid deadlocks,
+   * and unlocks them when destroyed.
+   */
+  class StripeLock {
+
+    std::vector<std::unique_lock<tl::mutex>> m_held;
+
+  public:
+
+    StripeLock(std::array<tl::mutex, s_lock_stripes>& locks,
+               const std::vector<uint64_t>& ids) {
+        std::vector<size_t> stripes;
+        stripes.reserve(ids.size());
+        for(auto id : ids) stripes.push_back(id % s_lock_stripes);
+        std::sort(stripes.begin(), stripes.end());
+        stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+        for(auto s : stripes) m_held.emplace_back(locks[s]);
+    }
+  };
+
+  /**
+   * @brief Loads the stored documents, which must all exist.
+   */
+  static std::vector<std::string> loadStored(yokan::Collection& coll,
+                                             const std::vector<uint64_t>& ids) {
+      const auto count = ids.size();
+      std::vector<size_t> sizes(count);
+      coll.lengthMulti(count, ids.data(), sizes.data());
+      std::vector<std::string> docs(count);
+      std::vector<void*> ptrs(count);
+      for(size_t i = 0; i < count; ++i) {
+          if(sizes[i] == YOKAN_KEY_NOT_FOUND)
+              throw Exception{"Record " + std::to_string(ids[i]) + " does not exist"};
+          docs[i].resize(sizes[i]);
+          ptrs[i] = docs[i].data();
+      }
+      coll.loadMulti(count, ids.data(), ptrs.data(), sizes.data());
+      return docs;
+  }
+
+  static void updateStored(yokan::Collection& coll, const std::vector<uint64_t>& ids,
+                           const std::vector<std::string>& docs) {
+      const auto count = ids.size();
+      std::vector<const void*> ptrs(count);
+      std::vector<size_t>      sizes(count);
+      for(size_t i = 0; i < count; ++i) {
+          ptrs[i]  = docs[i].data();
+          sizes[i] = docs[i].size();
+      }
+      coll.updateMulti(count, ids.data(), ptrs.data(), sizes.data());
+  }
+
+  yokan::Collection open(const std::string& db_name, const std::string& coll_name) const {
+      auto db = m_client.findDatabaseByName(m_self.get_addr(), m_provider_id, db_name.c_str());
+      return yokan::Collection{coll_name.c_str(), db};
+  }
+
+  /**
+   * @brief Calls modify(i, doc) for each ids[i], in order, updating
+   * the documents only if it succeeds on every one of them. A document
+   * whose id is repeated is modified once per occurrence.
+   */
+  template<typename Modify>
+  void modifyDocs(const std::string& db_name, const std::string& coll_name,
+                  DocumentFormat format, const std::vector<uint64_t>& ids,
+                  Modify&& modify) {
+      std::vector<uint64_t> unique{ids};
+      std::sort(unique.begin(), unique.end());
+      unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+      auto coll = open(db_name, coll_name);
+      StripeLock lock{m_locks, unique};
+      auto stored = loadStored(coll, unique);
+      std::vector<json> docs(unique.size());
+      for(size_t k = 0; k < unique.size(); ++k)
+          docs[k] = parseStored(format, stored[k]);
+      for(size_t i = 0; i < ids.size(); ++i)
+          modify(i, docs[std::lower_bound(unique.begin(), unique.end(), ids[i]) - unique.begin()]);
+      for(size_t k = 0; k < unique.size(); ++k)
+          dumpStored(format, docs[k], stored[k]);
+      updateStored(coll, unique, stored);
+  }
+
+  void patch(const tl::request& req, const std::string& db_name,
+             const std::string& coll_name, const std::string& format,
+             const std::vector<uint64_t>& ids, const std::string& patch) {
+      try {
+          auto p = json::parse(patch);
+          modifyDocs(db_name, coll_name, parse_format(format), ids,
+                     [&p](size_t, json& doc) { applyPatch(doc, p); });
+          req.respond(std::string{});
+      } catch(const std::exception& ex) {
+          req.respond(std::string{ex.what()});
+      }
+  }
+
+  void increment(const tl::request& req, const std::string& db_name,
+                 const std::string& coll_name, const std::string& format,
+                 const std::vector<uint64_t>& ids, const std::string& field,
+                 const std::string& delta) {
+      try {
+          auto pointer = json::json_pointer{field};
+          auto d = json::parse(delta);
+          json::array_t values(ids.size());
+          modifyDocs(db_name, coll_name, parse_format(format), ids,
+                     [&](size_t i, json& doc) { values[i] = incrementField(doc, pointer, d); });
+          req.respond(std::make_pair(std::string{}, json(std::move(values)).dump()));
+      } catch(const std::exception& ex) {
+          req.respond(std::make_pair(std::string{ex.what()}, std::string{}));
+      }
+  }
+
+  /**
+   * @brief Replaces the stored documents, which the provider cannot
+   * decode when they are compressed, only if they are all still equal
+   * to the expected bytes. Responds with an error message and whether
+   * the documents were replaced.
+   */
+  void swap(const tl::request& req, const std::string& db_name,
+            const std::string& coll_name, const std::vector<uint64_t>& ids,
+            const std::vector<std::string>& expected,
+            const std::vector<std::string>& replacement) {
+      try {
+          if(expected.size() != ids.size() || replacement.size() != ids.size())
+              throw Exception{"Invalid number of documents"};
+          auto coll = open(db_name, coll_name);
+          StripeLock lock{m_locks, ids};
+          if(loadStored(coll, ids) != expected) {
+              req.respond(std::make_pair(std::string{}, false));
+              return;
+          }
+          updateStored(coll, ids, replacement);
+          req.respond(std::make_pair(std::string{}, true));
+      } catch(const std::exception& ex) {
+          req.respond(std::make_pair(std::string{ex.what()}, false));
+      }
+  }
+
+public:
+
+  static constexpr const char* s_patch_rpc_name = "isonata_yokan_patch";
+  static constexpr const char* s_increment_rpc_name = "isonata_yokan_increment";
+  static constexpr const char* s_swap_rpc_name = "isonata_yokan_swap";
+
+  YokanPatchProvider(const tl::engine& engine, uint16_t provider_id,
+                     const tl::pool& pool)
+  : tl::provider<YokanPatchProvider>(engine, provider_id)
+  , m_client(engine.get_margo_instance())
+  , m_self(engine.self())
+  , m_provider_id(provider_id) {
+      define(s_patch_rpc_name, &YokanPatchProvider::patch, pool);
+      define(s_increment_rpc_name, &YokanPatchProvider::increment, pool);
+      define(s_swap_rpc_name, &YokanPatchProvider::swap, pool);
+  }
+};
+
+} // namespace isonata
+
+#endif
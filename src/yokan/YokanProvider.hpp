@@ -6,6 +6,8 @@
 #include <isonata/Provider.hpp>
 #include <isonata/Exception.hpp>
 #include <yokan/cxx/server.hpp>
+#include "YokanFilters.hpp"
+#include "YokanPatchProvider.hpp"
 
 namespace isonata {
 
@@ -13,13 +15,16 @@ namespace tl = thallium;
 
 class YokanProvider : public AbstractProviderImpl {
 
-  yokan::Provider m_provider;
+  yokan::Provider    m_provider;
+  YokanPatchProvider m_patch_provider;
 
 public:
 
-  template<typename ... Args>
-  YokanProvider(Args&&... args)
-  : m_provider{std::forward<Args>(args)...} {}
+  YokanProvider(const tl::engine& engine, uint16_t provider_id,
+                const std::string& config, const tl::pool& pool)
+  : m_provider{engine.get_margo_instance(), provider_id, "",
+               config.c_str(), pool.native_handle()}
+  , m_patch_provider{engine, provider_id, pool} {}
 
   virtual ~YokanProvider() = default;
 
@@ -0,0 +1,235 @@
+/*
+ * (C) 2023 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __ISONATA_YOKAN_WORK_QUEUE_HPP
+#define __ISONATA_YOKAN_WORK_QUEUE_HPP
+
+#include "../OperationAsyncRequest.hpp"
+#include "../ChunkedOperation.hpp"
+#include <thallium.hpp>
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace isonata {
+
+namespace tl = thallium;
+
+/**
+ * @brief The YokanWorkQueue executes the asynchronous operations of
+ * the Yokan backend. Submitting an operation only pushes it into a
+ * queue; worker ULTs pop operations from the queue and complete their
+ * request. A worker is created only when an operation is pushed while
+ * all the existing workers are busy, up to a configured maximum, so
+ * the number of ULTs, and of RPCs in flight, follows the depth of the
+ * queue without exceeding that maximum. Workers are kept until the
+ * queue is destroyed.
+ *
+ * The workers run either in a pool provided by the user (e.g. the
+ * engine's progress pool) or in a dedicated pool served by execution
+ * streams that the queue creates on first use, so that serialization
+ * work done by the operations does not compete with network progress.
+ * The same pool runs the ULTs among which parallel_for splits the
+ * serialization and parsing of large batches.
+ */
+class YokanWorkQueue {
+
+  /**
+   * @brief State shared by the queue and its workers. It is kept in a
+   * shared_ptr so that, when the queue is destroyed by one of its own
+   * operations, another ULT can join the workers after the destructor
+   * returned.
+   */
+  struct State {
+
+    tl::pool                               m_pool;
+    size_t                                 m_num_workers;
+    size_t                                 m_num_xstreams = 0;
+    std::optional<tl::managed<tl::pool>>   m_owned_pool;
+    std::vector<tl::managed<tl::xstream>>  m_xstreams;
+    tl::mutex                              m_mutex;
+    tl::condition_variable                 m_cv;
+    std::deque<std::shared_ptr<OperationAsyncRequest>> m_queue;
+    std::vector<tl::managed<tl::thread>>   m_workers;
+    std::vector<uint64_t>                  m_worker_ids;
+    size_t                                 m_idle = 0;
+    size_t                                 m_starting = 0;
+    bool                                   m_started = false;
+    bool                                   m_stop = false;
+
+    void work() {
+        {
+            std::unique_lock<tl::mutex> lock{m_mutex};
+            m_worker_ids.push_back(tl::thread::self_id());
+            m_starting -= 1;
+        }
+        while(true) {
+            std::shared_ptr<OperationAsyncRequest> op;
+            {
+                std::unique_lock<tl::mutex> lock{m_mutex};
+                m_idle += 1;
+                m_cv.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+                m_idle -= 1;
+                if(m_queue.empty()) return;
+                op = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            op->run();
+        }
+    }
+
+    /**
+     * @brief Creates the pool and execution streams, if not done yet.
+     * Called with m_mutex held.
+     */
+    void start() {
+        if(m_started) return;
+        m_started = true;
+        if(m_num_xstreams) {
+            m_owned_pool = tl::pool::create(tl::pool::access::mpmc);
+            m_pool = **m_owned_pool;
+            m_xstreams.reserve(m_num_xstreams);
+            for(size_t i = 0; i < m_num_xstreams; ++i)
+                m_xstreams.push_back(tl::xstream::create(
+                    tl::scheduler::predef::basic_wait, m_pool));
+        }
+    }
+
+    /**
+     * @brief Creates a worker if the queue holds more operations than
+     * there are workers about to pop them and the maximum number of
+     * workers is not reached. Called with m_mutex held.
+     */
+    void grow() {
+        if(m_workers.size() >= m_num_workers) return;
+        if(m_queue.size() <= m_idle + m_starting) return;
+        m_starting += 1;
+        m_workers.push_back(m_pool.make_thread([this]() { work(); }));
+    }
+
+    /**
+     * @brief Waits for the workers, which drain the queue, and for the
+     * execution streams. Must not be called by a worker.
+     */
+    void join() {
+        for(auto& ult : m_workers) ult->join();
+        m_workers.clear();
+        m_xstreams.clear();
+    }
+  };
+
+  std::shared_ptr<State> m_state = std::make_shared<State>();
+  size_t                 m_num_serializers;
+  tl::pool               m_home = tl::xstream::self().get_main_pools(1)[0];
+
+public:
+
+  /**
+   * @brief Default maximum number of workers, hence of operations
+   * running at once. Workers are only created as the queue deepens.
+   */
+  static constexpr size_t s_default_num_workers = 1024;
+
+  static constexpr size_t s_default_num_xstreams = 1;
+
+  static constexpr size_t s_min_per_serializer = 256;
+
+  /**
+   * @brief Runs the workers in the provided pool. parallel_for splits
+   * its work across at most num_serializers ULTs.
+   */
+  YokanWorkQueue(const tl::pool& pool, size_t num_workers = s_default_num_workers,
+                 size_t num_serializers = 1)
+  : m_num_serializers(num_serializers ? num_serializers : 1) {
+      m_state->m_pool = pool;
+      m_state->m_num_workers = num_workers ? num_workers : 1;
+  }
+
+  /**
+   * @brief Runs the workers in a dedicated pool served by
+   * num_xstreams execution streams. parallel_for splits its work
+   * across at most num_serializers ULTs, by default one per
+   * execution stream.
+   */
+  YokanWorkQueue(size_t num_xstreams, size_t num_workers, size_t num_serializers = 0)
+  : m_num_serializers(num_serializers ? num_serializers : (num_xstreams ? num_xstreams : 1)) {
+      m_state->m_num_workers = num_workers ? num_workers : 1;
+      m_state->m_num_xstreams = num_xstreams ? num_xstreams : 1;
+  }
+
+  YokanWorkQueue(const YokanWorkQueue&) = delete;
+  YokanWorkQueue(YokanWorkQueue&&) = delete;
+
+  /**
+   * @brief Stops the workers once the queue is drained. If called from
+   * a worker, e.g. when an operation releases the last reference to
+   * the client, the worker cannot join itself: the workers are then
+   * joined by an anonymous ULT in the pool that created the queue.
+   */
+  ~YokanWorkQueue() {
+      bool in_worker = false;
+      {
+          std::unique_lock<tl::mutex> lock{m_state->m_mutex};
+          m_state->m_stop = true;
+          const auto& ids = m_state->m_worker_ids;
+          in_worker = std::find(ids.begin(), ids.end(), tl::thread::self_id()) != ids.end();
+      }
+      m_state->m_cv.notify_all();
+      if(!in_worker) {
+          m_state->join();
+          return;
+      }
+      m_home.make_thread([state = m_state]() { state->join(); }, tl::anonymous{});
+  }
+
+  /**
+   * @brief Enqueues an operation.
+   */
+  void push(std::shared_ptr<OperationAsyncRequest> op) {
+      {
+          std::unique_lock<tl::mutex> lock{m_state->m_mutex};
+          m_state->start();
+          m_state->m_queue.push_back(std::move(op));
+          m_state->grow();
+      }
+      m_state->m_cv.notify_one();
+  }
+
+  /**
+   * @brief Calls f(i) for every i in [0, count). The indices are split
+   * into contiguous ranges of at least s_min_per_serializer indices,
+   * processed by the calling ULT and by ULTs created in the queue's
+   * pool, so that CPU-bound work such as serializing or parsing the
+   * documents of a large batch runs on all the execution streams.
+   * Rethrows the first exception thrown by f.
+   */
+  template<typename Function>
+  void parallel_for(size_t count, Function&& f) {
+      const auto per_ult = std::max(s_min_per_serializer,
+                                    (count + m_num_serializers - 1)/m_num_serializers);
+      if(m_num_serializers <= 1 || count <= per_ult) {
+          for(size_t i = 0; i < count; ++i) f(i);
+          return;
+      }
+      tl::pool pool;
+      {
+          std::unique_lock<tl::mutex> lock{m_state->m_mutex};
+          m_state->start();
+          pool = m_state->m_pool;
+      }
+      auto chunks = splitChunks(count, per_ult, std::numeric_limits<size_t>::max(),
+                                [](size_t) { return size_t{0}; });
+      runChunks(pool, chunks, m_num_serializers,
+          [&f](const Chunk& c) { for(auto i = c.begin; i < c.end; ++i) f(i); },
+          [](const Chunk&) {});
+  }
+};
+
+} // namespace isonata
+
+#endif
@@ -8,6 +8,19 @@
 #include <isonata/Client.hpp>
 #include <isonata/Collection.hpp>
 #include <isonata/Database.hpp>
+#include <isonata/JsonCodec.hpp>
+#include <isonata/AsyncRequestSet.hpp>
+#include <isonata/Cursor.hpp>
+#include <isonata/RequestQueue.hpp>
+#include <Config.hpp>
+#ifdef ENABLE_YOKAN
+#include <yokan/cxx/client.hpp>
+#include <yokan/cxx/collection.hpp>
+#endif
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <set>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_all.hpp>
 #include <catch2/generators/catch_generators.hpp>
@@ -16,10 +29,54 @@ using namespace Catch::Generators;
 
 
 using json = nlohmann::json;
+namespace tl = thallium;
 
 static const std::string resource_type = "unqlite";
 static constexpr const char* resource_config = "{ \"path\" : \"mydb\", \"mode\":\"create\" }";
 
+/**
+ * @brief Request that completes only when the test calls release(),
+ * used to hold a slot of a RequestQueue deterministically.
+ */
+struct HeldRequest : public isonata::AbstractAsyncRequestImpl {
+
+    mutable tl::eventual<void>                 released;
+    mutable tl::mutex                          mutex;
+    mutable bool                               done = false;
+    mutable std::vector<std::function<void()>> callbacks;
+
+    void release() {
+        std::vector<std::function<void()>> to_run;
+        {
+            std::unique_lock<tl::mutex> lock{mutex};
+            done = true;
+            to_run.swap(callbacks);
+        }
+        released.set_value();
+        for(auto& cb : to_run) cb();
+    }
+
+    void wait() const override { released.wait(); }
+
+    bool completed() const override { return released.test(); }
+
+    uint64_t on_completion(std::function<void()> callback) const override {
+        {
+            std::unique_lock<tl::mutex> lock{mutex};
+            if(!done) {
+                callbacks.push_back(std::move(callback));
+                return callbacks.size();
+            }
+        }
+        callback();
+        return 0;
+    }
+
+    void remove_callback(uint64_t) const override {}
+
+    operator bool() const override { return true; }
+};
+
 TEST_CASE("Client tests", "[client]") {
 
     auto backend = GENERATE(as<std::string>{}, "yokan");//, "sonata");
@@ -68,6 +125,100 @@ TEST_CASE("Client tests", "[client]") {
             db.drop("mycollection");
         }
 
+        SECTION("Filter collection") {
+            auto coll = db.create("mycollection");
+
+            for(const auto& doc : docs)
+                REQUIRE_NOTHROW(coll.store(doc));
+
+            std::string filterCode = backend == "yokan"
+                ? "return string.find(__doc__, \"Rob\") ~= nil"
+                : "function($record) { return $record.name == \"Rob\"; }";
+
+            json result;
+            REQUIRE_NOTHROW(coll.filter(filterCode, &result));
+            REQUIRE(result.is_array());
+            REQUIRE(result.size() == 1);
+            REQUIRE(result[0]["name"] == "Rob");
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Iterate over collection") {
+            auto coll = db.create("mycollection");
+
+            for(const auto& doc : docs)
+                REQUIRE_NOTHROW(coll.store(doc));
+            REQUIRE_NOTHROW(coll.erase(1));
+
+            std::vector<std::string> all_docs;
+            REQUIRE_NOTHROW(coll.all(&all_docs));
+            REQUIRE(all_docs.size() == 2);
+
+            size_t num_batches = 0;
+            std::vector<std::string> streamed;
+            REQUIRE_NOTHROW(coll.all(
+                [&](const std::vector<std::string>& batch) {
+                    REQUIRE(batch.size() <= 1);
+                    num_batches += 1;
+                    streamed.insert(streamed.end(), batch.begin(), batch.end());
+                }, 1));
+            REQUIRE(num_batches == 2);
+            REQUIRE(streamed == all_docs);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Fetch into a DocumentBatch") {
+            auto coll = db.create("mycollection");
+
+            for(const auto& doc : docs)
+                REQUIRE_NOTHROW(coll.store(doc));
+            REQUIRE_NOTHROW(coll.erase(1));
+
+            uint64_t ids[3] = {0, 1, 2};
+            isonata::DocumentBatch batch;
+            REQUIRE_NOTHROW(coll.fetch_multi(ids, 3, &batch));
+            REQUIRE(batch.size() == 2);
+            REQUIRE(batch.id(0) == 0);
+            REQUIRE(batch.id(1) == 2);
+            REQUIRE(batch.parse(1)["name"] == "Phil");
+
+            REQUIRE_NOTHROW(coll.all(&batch));
+            REQUIRE(batch.size() == 2);
+            size_t n = 0;
+            for(auto doc : batch) {
+                REQUIRE(doc.find("Rob") == std::string_view::npos);
+                n += 1;
+            }
+            REQUIRE(n == 2);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Store and update packed records") {
+            auto coll = db.create("mycollection");
+
+            std::string packed;
+            std::vector<size_t> sizes;
+            for(const auto& doc : docs) {
+                packed += doc;
+                sizes.push_back(doc.size());
+            }
+            uint64_t ids[3];
+            REQUIRE_NOTHROW(coll.store_multi(packed.data(), sizes.data(), 3, ids));
+            REQUIRE(coll.size() == 3);
+
+            std::string_view views[3] = {docs[2], docs[1], docs[0]};
+            REQUIRE_NOTHROW(coll.update_multi(ids, views, 3, nullptr));
+
+            json record;
+            REQUIRE_NOTHROW(coll.fetch(ids[0], &record));
+            REQUIRE(record["name"] == "Phil");
+
+            db.drop("mycollection");
+        }
+
         SECTION("Access collection without blocking") {
             auto coll = db.create("mycollection");
 
@@ -92,6 +243,584 @@ TEST_CASE("Client tests", "[client]") {
             REQUIRE(record.contains("name"));
             REQUIRE(record["name"] == "Rob");
 
+            tl::eventual<std::string> continued;
+            REQUIRE_NOTHROW(coll.fetch(2, &record, &fetch_req));
+            fetch_req.then([&continued, &record](const isonata::AsyncRequest& req) {
+                req.wait();
+                continued.set_value(record["name"].get<std::string>());
+            });
+            REQUIRE(continued.wait() == "Phil");
+
+            isonata::AsyncRequest bad_req;
+            REQUIRE_NOTHROW(coll.fetch(42, &record, &bad_req));
+            REQUIRE_THROWS_AS(bad_req.wait(), isonata::Exception);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Wait on sets of requests") {
+            auto coll = db.create("mycollection");
+
+            isonata::AsyncRequest store_reqs[3];
+            uint64_t record_ids[3];
+            for(unsigned i = 0; i < 3; ++i)
+                REQUIRE_NOTHROW(coll.store(docs[i], &record_ids[i], false, &store_reqs[i]));
+            auto index = isonata::wait_any(store_reqs, 3);
+            REQUIRE(index < 3);
+            REQUIRE(store_reqs[index].completed());
+            REQUIRE_NOTHROW(isonata::wait_all(store_reqs, 3));
+            REQUIRE(isonata::test_some(store_reqs, 3).size() == 3);
+            REQUIRE(coll.size() == 3);
+
+            isonata::AsyncRequestSet set;
+            std::vector<std::string> results(3);
+            for(unsigned i = 0; i < 3; ++i) {
+                isonata::AsyncRequest req;
+                REQUIRE_NOTHROW(coll.fetch(record_ids[i], &results[i], &req));
+                set.add(std::move(req));
+            }
+            REQUIRE(set.size() == 3);
+            auto completed = set.wait_any();
+            REQUIRE_NOTHROW(completed.second.wait());
+            REQUIRE(set.size() == 2);
+            REQUIRE_NOTHROW(set.wait_all());
+            REQUIRE(set.empty());
+            for(unsigned i = 0; i < 3; ++i)
+                REQUIRE(json::parse(results[i]) == json::parse(docs[i]));
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Access collection with owned payloads") {
+            auto coll = db.create("mycollection");
+
+            auto r0 = coll.store_async(std::string(docs[0]));
+            auto r1 = coll.store_async(json::parse(docs[1]));
+            auto r2 = coll.store_multi_async(std::vector<std::string>{docs[2]});
+            REQUIRE(r2.get().size() == 1);
+            // the stores may complete in any order
+            REQUIRE(std::set<uint64_t>{r0.get(), r1.get(), r2.get()[0]}.size() == 3);
+
+            auto f0 = coll.fetch_async(r0.get());
+            auto f1 = coll.fetch_json_async(r1.get());
+            auto f2 = coll.fetch_async(r2.get()[0]);
+            REQUIRE(json::parse(f0.get()) == json::parse(docs[0]));
+            REQUIRE(f1.get() == json::parse(docs[1]));
+            REQUIRE(json::parse(f2.get()) == json::parse(docs[2]));
+
+            auto u = coll.update_async(r0.get(), std::string(docs[2]));
+            REQUIRE_NOTHROW(u.wait());
+            REQUIRE(u.completed());
+            REQUIRE(coll.fetch_json_async(r0.get()).get() == json::parse(docs[2]));
+
+            auto missing = coll.fetch_async(coll.last_record_id() + 42);
+            REQUIRE_THROWS_AS(missing.get(), isonata::Exception);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Coalesce individual stores") {
+            auto coll = db.create("mycollection");
+            isonata::AsyncRequest last_req;
+            uint64_t last;
+            {
+                isonata::CoalescingOptions options;
+                options.max_records = 2;
+                options.linger_ms = 10.0;
+                auto coalescing = coll.coalescing(options);
+
+                isonata::AsyncRequest reqs[3];
+                uint64_t ids[3];
+                for(unsigned i = 0; i < 3; ++i)
+                    REQUIRE_NOTHROW(coalescing.store(docs[i], &ids[i], false, &reqs[i]));
+                REQUIRE_NOTHROW(isonata::wait_all(reqs, 3));
+                for(unsigned i = 0; i < 3; ++i)
+                    REQUIRE(ids[i] == i);
+
+                auto id = coalescing.store(docs[0]);
+                REQUIRE(id == 3);
+                auto result = coalescing.store_async(json::parse(docs[1]));
+                REQUIRE(result.get() == 4);
+                REQUIRE(coalescing.size() == 5);
+                REQUIRE(coalescing.fetch_json_async(4).get() == json::parse(docs[1]));
+
+                options.linger_ms = 1e6;
+                coalescing = coll.coalescing(options);
+                REQUIRE_NOTHROW(coalescing.store(docs[2], &last, false, &last_req));
+            }
+            REQUIRE_NOTHROW(last_req.wait());
+            REQUIRE(last == 5);
+            REQUIRE(coll.size() == 6);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Combine concurrent fetches") {
+            auto coll = db.create("mycollection");
+            std::vector<uint64_t> ids(3);
+            REQUIRE_NOTHROW(coll.store_multi(docs, ids.data()));
+            {
+                isonata::CombiningOptions options;
+                options.max_records = 3;
+                options.linger_ms = 10.0;
+                auto combining = coll.combining(options);
+
+                isonata::AsyncRequest reqs[4];
+                std::string results[3];
+                json missing;
+                for(unsigned i = 0; i < 3; ++i)
+                    REQUIRE_NOTHROW(combining.fetch(ids[i], &results[i], &reqs[i]));
+                REQUIRE_NOTHROW(combining.fetch(42, &missing, &reqs[3]));
+                REQUIRE_NOTHROW(isonata::wait_all(reqs, 3));
+                REQUIRE_THROWS_AS(reqs[3].wait(), isonata::Exception);
+                for(unsigned i = 0; i < 3; ++i)
+                    REQUIRE(json::parse(results[i]) == json::parse(docs[i]));
+
+                auto a = combining.fetch_async(ids[1]);
+                auto b = combining.fetch_json_async(ids[1]);
+                REQUIRE(json::parse(a.get()) == json::parse(docs[1]));
+                REQUIRE(b.get() == json::parse(docs[1]));
+
+                json doc;
+                REQUIRE_NOTHROW(combining.fetch(ids[2], &doc));
+                REQUIRE(doc == json::parse(docs[2]));
+                REQUIRE(combining.size() == 3);
+            }
+            db.drop("mycollection");
+        }
+
+        SECTION("Map a collection from a local file") {
+            auto coll = db.create("mycollection");
+            std::vector<uint64_t> ids(3);
+            REQUIRE_NOTHROW(coll.store_multi(docs, ids.data()));
+            const std::string path = "mycollection.map";
+            std::remove(path.c_str());
+
+            auto mapped = coll.mapped(path);
+            REQUIRE(mapped.size() == 3);
+            std::string doc;
+            REQUIRE_NOTHROW(mapped.fetch(ids[1], &doc));
+            REQUIRE(json::parse(doc) == json::parse(docs[1]));
+            REQUIRE_THROWS_AS(mapped.fetch(42, &doc), isonata::Exception);
+            isonata::DocumentBatch batch;
+            REQUIRE_NOTHROW(mapped.all(&batch));
+            REQUIRE(batch.size() == 3);
+            REQUIRE(batch.id(2) == ids[2]);
+            REQUIRE_THROWS_AS(mapped.store(docs[0]), isonata::Exception);
+            REQUIRE_THROWS_AS(mapped.erase(ids[0]), isonata::Exception);
+
+            // the file is reused without validation, and rebuilt
+            // once it no longer matches the collection
+            REQUIRE_NOTHROW(coll.store(docs[0]));
+            REQUIRE(coll.mapped(path, false).size() == 3);
+            REQUIRE(coll.mapped(path).size() == 4);
+
+            std::remove(path.c_str());
+            db.drop("mycollection");
+        }
+
+        SECTION("Iterate with a cursor") {
+            auto coll = db.create("mycollection");
+            std::vector<std::string> many;
+            for(unsigned i = 0; i < 10; ++i)
+                many.push_back("{\"value\":" + std::to_string(i) + "}");
+            std::vector<uint64_t> ids(many.size());
+            REQUIRE_NOTHROW(coll.store_multi(many, ids.data()));
+            REQUIRE_NOTHROW(coll.erase(ids[3]));
+
+            std::vector<uint64_t> seen;
+            for(auto& doc : coll.cursor(0, std::numeric_limits<uint64_t>::max(), 4)) {
+                REQUIRE(json::parse(doc.data()) == doc.parse());
+                REQUIRE(doc.parse()["value"] == doc.id() - ids[0]);
+                seen.push_back(doc.id());
+            }
+            REQUIRE(seen.size() == 9);
+            REQUIRE(std::find(seen.begin(), seen.end(), ids[3]) == seen.end());
+
+            auto cursor = coll.cursor(ids[5], ids[8], 2);
+            REQUIRE(cursor);
+            REQUIRE(cursor.id() == ids[5]);
+            cursor.next();
+            cursor.next();
+            REQUIRE(cursor.id() == ids[7]);
+            cursor.next();
+            REQUIRE(!cursor);
+            REQUIRE_THROWS_AS(cursor.next(), isonata::Exception);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Store and fetch batches larger than a chunk") {
+            auto coll = db.create("mycollection");
+            std::vector<std::string> many;
+            for(unsigned i = 0; i < 10000; ++i)
+                many.push_back("{\"value\":" + std::to_string(i) + "}");
+            std::vector<uint64_t> ids(many.size());
+            REQUIRE_NOTHROW(coll.store_multi(many, ids.data()));
+            REQUIRE(coll.size() == many.size());
+            REQUIRE(std::set<uint64_t>(ids.begin(), ids.end()).size() == ids.size());
+
+            std::vector<std::string> fetched;
+            REQUIRE_NOTHROW(coll.fetch_multi(ids.data(), ids.size(), &fetched));
+            REQUIRE(fetched.size() == many.size());
+            isonata::DocumentBatch batch;
+            REQUIRE_NOTHROW(coll.fetch_multi(ids.data(), ids.size(), &batch));
+            REQUIRE(batch.size() == many.size());
+            for(size_t i = 0; i < many.size(); i += 997) {
+                REQUIRE(json::parse(fetched[i]) == json::parse(many[i]));
+                REQUIRE(batch.id(i) == ids[i]);
+                REQUIRE(batch.parse(i) == json::parse(many[i]));
+            }
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Route json documents through a codec") {
+            struct CountingCodec : public isonata::JsonCodec {
+                std::shared_ptr<isonata::JsonCodec> inner = isonata::JsonCodec::get("nlohmann");
+                mutable std::atomic<size_t> dumps{0};
+                mutable std::atomic<size_t> parses{0};
+                std::string name() const override { return "counting"; }
+                void dump(const json& value, std::string& out) const override {
+                    dumps++;
+                    inner->dump(value, out);
+                }
+                json parse(std::string_view doc) const override {
+                    parses++;
+                    return inner->parse(doc);
+                }
+                bool sax_parse(std::string_view doc, json::json_sax_t& handler) const override {
+                    return inner->sax_parse(doc, handler);
+                }
+            };
+            auto codec = std::make_shared<CountingCodec>();
+            isonata::JsonCodec::add(codec);
+            REQUIRE_THROWS_AS(isonata::JsonCodec::set_default("unknown"), isonata::Exception);
+            // restores the default codec even if a REQUIRE fails
+            struct DefaultCodec {
+                std::string previous = isonata::JsonCodec::current().name();
+                DefaultCodec(const std::string& name) { isonata::JsonCodec::set_default(name); }
+                ~DefaultCodec() { isonata::JsonCodec::set_default(previous); }
+            } counting{"counting"};
+            REQUIRE_FALSE(isonata::JsonCodec::current_is_native());
+
+            auto coll = db.create("mycollection");
+            auto id = coll.store(json::parse(docs[0]));
+            std::vector<uint64_t> ids(2);
+            REQUIRE_NOTHROW(coll.store_multi(json::array({json::parse(docs[1]), json::parse(docs[2])}),
+                                             ids.data()));
+            json doc;
+            REQUIRE_NOTHROW(coll.fetch(id, &doc));
+            REQUIRE(doc["name"] == json::parse(docs[0])["name"]);
+            REQUIRE_NOTHROW(coll.fetch_multi(ids.data(), ids.size(), &doc));
+            REQUIRE(doc.size() == 2);
+            REQUIRE(codec->dumps >= 3);
+            REQUIRE(codec->parses >= 3);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Store documents in a binary format") {
+            REQUIRE_THROWS_AS(db.create("mycollection", {{"format", "xml"}}), isonata::Exception);
+            auto format = GENERATE(as<std::string>{}, "cbor", "msgpack", "bson");
+            uint64_t id;
+            std::vector<uint64_t> ids(2);
+            {
+                auto coll = db.create("mycollection", {{"format", format}});
+                id = coll.store(docs[0]);
+                REQUIRE_NOTHROW(coll.store_multi(json::array({json::parse(docs[1]), json::parse(docs[2])}),
+                                                 ids.data()));
+                REQUIRE_NOTHROW(coll.update(ids[1], "{\"name\":\"Philip\"}"));
+            }
+            // the format is recorded with the collection
+            auto coll = db.open("mycollection");
+            std::string doc;
+            REQUIRE_NOTHROW(coll.fetch(id, &doc));
+            REQUIRE(json::parse(doc) == json::parse(docs[0]));
+            json record;
+            REQUIRE_NOTHROW(coll.fetch(ids[1], &record));
+            REQUIRE(record["name"] == "Philip");
+            isonata::DocumentBatch batch;
+            REQUIRE_NOTHROW(coll.all(&batch));
+            REQUIRE(batch.size() == 3);
+            REQUIRE(batch.parse(1) == json::parse(docs[1]));
+            // Lua filters would see the stored bytes
+            json result;
+            REQUIRE_THROWS_AS(coll.filter("return true", &result), isonata::Exception);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Compress documents") {
+            REQUIRE_THROWS_AS(db.create("mycollection", {{"compression", "rot13"}}), isonata::Exception);
+#ifdef ENABLE_ZSTD
+            auto samples = json::array();
+            for(unsigned i = 0; i < 1000; ++i)
+                samples.push_back({{"name", "user" + std::to_string(i % 37)}, {"rank", i}});
+            auto format = GENERATE(as<std::string>{}, "json", "cbor");
+            auto dictionary = GENERATE(false, true);
+            json compression = {{"method", "zstd"}, {"level", 5}};
+            if(dictionary) compression["dictionary_samples"] = samples;
+            std::vector<uint64_t> ids(docs.size());
+            {
+                auto coll = db.create("mycollection", {{"format", format}, {"compression", compression}});
+                REQUIRE_NOTHROW(coll.store_multi(docs, ids.data()));
+            }
+            auto coll = db.open("mycollection");
+            std::vector<std::string> fetched;
+            REQUIRE_NOTHROW(coll.fetch_multi(ids.data(), ids.size(), &fetched));
+            REQUIRE(fetched.size() == docs.size());
+            for(size_t i = 0; i < docs.size(); ++i)
+                REQUIRE(json::parse(fetched[i]) == json::parse(docs[i]));
+            json record;
+            REQUIRE_NOTHROW(coll.update(ids[1], json{{"name", "Robert"}}));
+            REQUIRE_NOTHROW(coll.fetch(ids[1], &record));
+            REQUIRE(record["name"] == "Robert");
+            // patches of compressed documents are swapped in by the provider
+            REQUIRE_NOTHROW(coll.patch(ids[1], {{"tags", json::array()}}));
+            std::vector<uint64_t> patched = {ids[1], ids[1]};
+            REQUIRE_NOTHROW(coll.patch_multi(patched.data(), patched.size(), json::array({
+                {{"op", "add"}, {"path", "/tags/-"}, {"value", "x"}}
+            })));
+            REQUIRE_NOTHROW(coll.fetch(ids[1], &record));
+            REQUIRE(record["name"] == "Robert");
+            REQUIRE(record["tags"] == json{"x", "x"});
+
+            db.drop("mycollection");
+#endif
+        }
+
+        SECTION("Fetch selected fields") {
+            auto coll = db.create("mycollection");
+            std::vector<uint64_t> ids(3);
+            REQUIRE_NOTHROW(coll.store_multi(json::array({
+                {{"name", "Matthieu"}, {"position", {{"x", 1}, {"y", 2}}}, {"tags", {"a", "b"}}},
+                {{"name", "Rob"}, {"position", {{"x", 3}, {"y", 4}}}},
+                {{"name", "Phil"}}
+            }), ids.data()));
+
+            json doc;
+            REQUIRE_NOTHROW(coll.fetch(ids[0], {"name", "/position/y", "/tags/1"}, &doc));
+            REQUIRE(doc == json{{"name", "Matthieu"}, {"position", {{"y", 2}}}, {"tags", {nullptr, "b"}}});
+
+            // fields missing from a document are omitted
+            std::vector<uint64_t> some = {ids[2], ids[0]};
+            REQUIRE_NOTHROW(coll.fetch_multi(some.data(), some.size(), {"/position/x"}, &doc));
+            REQUIRE(doc == json::array({json::object(), {{"position", {{"x", 1}}}}}));
+            REQUIRE_THROWS_AS(coll.fetch(ids[2] + 100, {"name"}, &doc), isonata::Exception);
+
+            std::string filterCode = backend == "yokan"
+                ? "return string.find(__doc__, \"Rob\") ~= nil"
+                : "function($record) { return $record.name == \"Rob\"; }";
+            REQUIRE_NOTHROW(coll.filter(filterCode, {"/position/x"}, &doc));
+            REQUIRE(doc == json::array({{{"position", {{"x", 3}}}}}));
+            REQUIRE_NOTHROW(coll.filter("", {"name"}, &doc));
+            REQUIRE(doc.size() == 3);
+            REQUIRE(doc[2] == json{{"name", "Phil"}});
+
+            db.drop("mycollection");
+        }
+
+#ifdef ENABLE_YOKAN
+        SECTION("Select fields with the provider's filter") {
+            if(backend != "yokan") return;
+            auto coll = db.create("mycollection");
+            std::vector<uint64_t> ids(3);
+            REQUIRE_NOTHROW(coll.store_multi(json::array({
+                {{"name", "Matthieu"}, {"rank", 1}},
+                {{"name", "Rob"}, {"rank", 2}},
+                {{"name", "Phil"}, {"rank", 3}}
+            }), ids.data()));
+
+            // the filter is already registered, so its library name is
+            // empty, and its arguments follow its name
+            yokan::Client yk_client{engine.get_margo_instance()};
+            auto yk_db = yk_client.findDatabaseByName(engine.self().get_addr(), 0, "mydb");
+            yokan::Collection yk_coll{"mycollection", yk_db};
+            const std::string filter = ":isonata_projection:" + json{
+                {"fields", {"/rank"}}, {"format", "json"},
+                {"ids", {ids[0], ids[2]}}, {"last", ids[2]}}.dump();
+            std::vector<yk_id_t> found(3);
+            std::vector<size_t>  sizes(3);
+            std::string          buffer(4096, '\0');
+            REQUIRE_NOTHROW(yk_coll.listDocsPacked(ids[0], filter.data(), filter.size(), 3,
+                found.data(), buffer.size(), buffer.data(), sizes.data(),
+                YOKAN_MODE_INCLUSIVE|YOKAN_MODE_LIB_FILTER));
+            REQUIRE(found[0] == ids[0]);
+            REQUIRE(found[1] == ids[2]);
+            REQUIRE(json::parse(buffer.substr(0, sizes[0])) == json{{"rank", 1}});
+            REQUIRE(json::parse(buffer.substr(sizes[0], sizes[1])) == json{{"rank", 3}});
+
+            db.drop("mycollection");
+        }
+#endif
+
+        SECTION("Patch documents") {
+            auto coll = db.create("mycollection");
+            std::vector<uint64_t> ids(2);
+            REQUIRE_NOTHROW(coll.store_multi(json::array({
+                {{"name", "Matthieu"}, {"status", "idle"}, {"stats", {{"runs", 1}, {"fails", 0}}}},
+                {{"name", "Rob"}, {"status", "idle"}, {"tags", {"a"}}}
+            }), ids.data()));
+
+            json doc;
+            REQUIRE_NOTHROW(coll.patch(ids[0], {{"status", "running"}, {"stats", {{"runs", 2}, {"fails", nullptr}}}}));
+            REQUIRE_NOTHROW(coll.fetch(ids[0], &doc));
+            REQUIRE(doc["status"] == "running");
+            REQUIRE(doc["stats"] == json{{"runs", 2}});
+            REQUIRE(doc["name"] == "Matthieu");
+
+            REQUIRE_NOTHROW(coll.patch(ids[1], json::array({
+                {{"op", "test"}, {"path", "/status"}, {"value", "idle"}},
+                {{"op", "add"}, {"path", "/tags/-"}, {"value", "b"}},
+                {{"op", "remove"}, {"path", "/status"}}
+            })));
+            REQUIRE_NOTHROW(coll.fetch(ids[1], &doc));
+            REQUIRE(doc["tags"] == json{"a", "b"});
+            REQUIRE_FALSE(doc.contains("status"));
+            REQUIRE_THROWS_AS(coll.patch(ids[1], json::array({
+                {{"op", "test"}, {"path", "/name"}, {"value", "Phil"}}
+            })), isonata::Exception);
+
+            REQUIRE_NOTHROW(coll.patch_multi(ids.data(), ids.size(), {{"status", "done"}}));
+            REQUIRE_NOTHROW(coll.fetch_multi(ids.data(), ids.size(), &doc));
+            REQUIRE(doc[0]["status"] == "done");
+            REQUIRE(doc[1]["status"] == "done");
+            REQUIRE(doc[1]["name"] == "Rob");
+
+            std::vector<uint64_t> missing = {ids[0], ids[1] + 100};
+            REQUIRE_THROWS_AS(coll.patch_multi(missing.data(), missing.size(), {{"status", "lost"}}),
+                              isonata::Exception);
+            REQUIRE_NOTHROW(coll.fetch(ids[0], &doc));
+            REQUIRE(doc["status"] == "done");
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Increment fields") {
+            auto coll = db.create("mycollection");
+            std::vector<uint64_t> ids(2);
+            REQUIRE_NOTHROW(coll.store_multi(json::array({
+                {{"name", "job1"}, {"stats", {{"runs", 1}}}},
+                {{"name", "job2"}}
+            }), ids.data()));
+
+            json value;
+            REQUIRE_NOTHROW(coll.increment(ids[0], "/stats/runs", 2, &value));
+            REQUIRE(value == 3);
+            REQUIRE_NOTHROW(coll.increment(ids[0], "elapsed", 0.5, &value));
+            REQUIRE(value == 0.5);
+
+            // missing fields count as 0
+            REQUIRE_NOTHROW(coll.increment_multi(ids.data(), ids.size(), "/stats/runs", 1, &value));
+            REQUIRE(value == json::array({4, 1}));
+            json doc;
+            REQUIRE_NOTHROW(coll.fetch(ids[1], &doc));
+            REQUIRE(doc["stats"]["runs"] == 1);
+            REQUIRE(doc["name"] == "job2");
+
+            REQUIRE_THROWS_AS(coll.increment(ids[0], "name", 1), isonata::Exception);
+            REQUIRE_THROWS_AS(coll.increment(ids[1] + 100, "/stats/runs", 1), isonata::Exception);
+            REQUIRE_THROWS_AS(coll.increment(ids[0], "/stats/runs", "one"), isonata::Exception);
+            REQUIRE_NOTHROW(coll.fetch(ids[0], &doc));
+            REQUIRE(doc["stats"]["runs"] == 4);
+
+            // a repeated id is incremented once per occurrence
+            std::vector<uint64_t> repeated = {ids[1], ids[0], ids[1]};
+            REQUIRE_NOTHROW(coll.increment_multi(repeated.data(), repeated.size(), "/stats/runs", 1, &value));
+            REQUIRE(value == json::array({2, 5, 3}));
+            REQUIRE_NOTHROW(coll.fetch(ids[1], &doc));
+            REQUIRE(doc["stats"]["runs"] == 3);
+
+            // concurrent increments are not lost
+            constexpr size_t concurrent = 32;
+            std::vector<isonata::AsyncRequest> reqs(concurrent);
+            for(auto& req : reqs)
+                REQUIRE_NOTHROW(coll.increment(ids[0], "counter", 1, nullptr, false, &req));
+            for(auto& req : reqs)
+                REQUIRE_NOTHROW(req.wait());
+            REQUIRE_NOTHROW(coll.fetch(ids[0], &doc));
+            REQUIRE(doc["counter"] == concurrent);
+
+            uint64_t big;
+            REQUIRE_NOTHROW(coll.store(json{{"count", std::numeric_limits<uint64_t>::max() - 1}}, &big));
+            REQUIRE_NOTHROW(coll.increment(big, "count", 1, &value));
+            REQUIRE(value == std::numeric_limits<uint64_t>::max());
+            REQUIRE_THROWS_AS(coll.increment(big, "count", 1), isonata::Exception);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Fetch and erase ranges of records") {
+            auto coll = db.create("mycollection");
+            std::vector<std::string> many;
+            for(unsigned i = 0; i < 10; ++i)
+                many.push_back("{\"value\":" + std::to_string(i) + "}");
+            std::vector<uint64_t> ids(many.size());
+            REQUIRE_NOTHROW(coll.store_multi(many, ids.data()));
+            REQUIRE_NOTHROW(coll.erase(ids[3]));
+
+            isonata::DocumentBatch batch;
+            REQUIRE_NOTHROW(coll.fetch_range(ids[2], 4, &batch));
+            REQUIRE(batch.size() == 3);
+            REQUIRE(batch.id(0) == ids[2]);
+            REQUIRE(batch.id(1) == ids[4]);
+            REQUIRE(batch.parse(2) == json::parse(many[5]));
+
+            std::vector<std::string> range;
+            REQUIRE_NOTHROW(coll.fetch_range(ids[8], 100, &range));
+            REQUIRE(range.size() == 2);
+            REQUIRE(json::parse(range[1]) == json::parse(many[9]));
+
+            REQUIRE_NOTHROW(coll.erase_range(ids[0], 5));
+            REQUIRE(coll.size() == 5);
+            REQUIRE_NOTHROW(coll.fetch_range(ids[0], 10, &range));
+            REQUIRE(range.size() == 5);
+            REQUIRE(json::parse(range[0]) == json::parse(many[5]));
+
+            // the range ends at the last record
+            REQUIRE_NOTHROW(coll.erase_range(ids[8], std::numeric_limits<size_t>::max()));
+            REQUIRE(coll.size() == 3);
+
+            db.drop("mycollection");
+        }
+
+        SECTION("Bound the number of requests in flight") {
+            auto coll = db.create("mycollection");
+
+            std::vector<isonata::AsyncResult<uint64_t>> stored;
+            {
+                isonata::RequestQueue queue{coll, 2};
+                REQUIRE(queue.depth() == 2);
+                for(unsigned i = 0; i < 3; ++i) {
+                    stored.push_back(queue.store(std::string(docs[i])));
+                    REQUIRE(queue.in_flight() <= 2);
+                }
+                REQUIRE_NOTHROW(queue.flush());
+                REQUIRE(queue.in_flight() == 0);
+                for(unsigned i = 0; i < 3; ++i)
+                    REQUIRE(queue.fetch_json(stored[i].get()).get() == json::parse(docs[i]));
+                queue.fetch(42);
+                REQUIRE_THROWS_AS(queue.flush(), isonata::Exception);
+                REQUIRE_NOTHROW(queue.flush());
+            }
+            REQUIRE(coll.size() == 3);
+
+            isonata::RequestQueue reject{coll, 1, isonata::RequestQueue::Policy::Reject};
+            auto held = std::make_shared<HeldRequest>();
+            reject.submit([&held](const isonata::Collection&) {
+                isonata::AsyncResult<void> result;
+                *result.request_ptr() = isonata::AsyncRequest{held};
+                return result;
+            });
+            REQUIRE(reject.in_flight() == 1);
+            REQUIRE_THROWS_AS(reject.fetch(stored[0].get()), isonata::Exception);
+            held->release();
+            REQUIRE_NOTHROW(reject.flush());
+            auto u = reject.update(stored[0].get(), json::parse(docs[1]));
+            REQUIRE_NOTHROW(reject.flush());
+            REQUIRE(u.completed());
+
             db.drop("mycollection");
         }
 
@@ -99,6 +828,70 @@ TEST_CASE("Client tests", "[client]") {
 
     }
 
+    SECTION("Create client with an async configuration") {
+
+      std::vector<isonata::Client> clients;
+      clients.push_back(isonata::Client::create(engine, backend,
+          json::parse("{\"async\":{\"num_xstreams\":0,\"num_workers\":4}}")));
+      clients.push_back(isonata::Client::create(engine, backend,
+          json::parse("{\"async\":{\"num_xstreams\":2,\"num_serializers\":4}}")));
+      clients.push_back(isonata::Client::create(engine, backend,
+          tl::xstream::self().get_main_pools(1)[0]));
+      REQUIRE_THROWS_AS(isonata::Client::create(engine, backend,
+          json::parse("{\"async\":{\"num_workers\":-1}}")), isonata::Exception);
+
+      for(auto& client : clients) {
+        auto coll = client.open(addr, 0, "mydb").create("mycollection");
+        auto id = coll.store_async(std::string("{\"name\":\"Matthieu\"}"));
+        REQUIRE(coll.fetch_json_async(id.get()).get()["name"] == "Matthieu");
+
+        auto records = json::array();
+        for(unsigned i = 0; i < 2000; ++i) records.push_back({{"value", i}});
+        std::vector<uint64_t> ids(records.size());
+        REQUIRE_NOTHROW(coll.store_multi(records, ids.data()));
+        json fetched;
+        REQUIRE_NOTHROW(coll.fetch_multi(ids.data(), ids.size(), &fetched));
+        REQUIRE(fetched.size() == records.size());
+        REQUIRE(fetched[0]["value"] == 0);
+        REQUIRE(fetched[1999]["value"] == 1999);
+        client.open(addr, 0, "mydb").drop("mycollection");
+      }
+    }
+
+    SECTION("Cache documents on the client") {
+
+      auto cache = std::make_shared<isonata::DocumentCache>(1024);
+      auto client = isonata::Client::create(engine, backend).cached(cache);
+      auto db = client.open(addr, 0, "mydb");
+      auto coll = db.create("mycollection");
+
+      auto id = coll.store("{\"name\":\"Matthieu\"}");
+      std::string doc;
+      REQUIRE_NOTHROW(coll.fetch(id, &doc));
+      REQUIRE(cache->misses() == 1);
+      REQUIRE(cache->size() == 1);
+      REQUIRE(coll.fetch_json_async(id).get()["name"] == "Matthieu");
+      REQUIRE(cache->hits() == 1);
+
+      REQUIRE_NOTHROW(coll.update(id, "{\"name\":\"Rob\"}"));
+      REQUIRE(cache->size() == 0);
+      REQUIRE(json::parse(coll.fetch_async(id).get())["name"] == "Rob");
+      REQUIRE(cache->misses() == 2);
+
+      isonata::AsyncRequest req;
+      REQUIRE_NOTHROW(coll.erase(id, false, &req));
+      REQUIRE_NOTHROW(req.wait());
+      REQUIRE(cache->size() == 0);
+      REQUIRE_THROWS_AS(coll.fetch(id, &doc), isonata::Exception);
+
+      auto big = coll.store(std::string(2048, ' ') + "{}");
+      REQUIRE_NOTHROW(coll.fetch(big, &doc));
+      REQUIRE(cache->bytes() <= cache->capacity());
+
+      db.drop("mycollection");
+      REQUIRE(cache->size() == 0);
+    }
+
     // Destroy the database
     admin.destroyDatabase(addr, 0, "mydb");
 